@@ -0,0 +1,200 @@
+#pragma once
+
+// Formula and bailout policies for the escape-time kernel templates, see
+// KernelImpl.h. Kernels are instantiated for each of them, so the inner loop
+// has no branches on the formula. Included by kernel sources only.
+//
+// Formulas with DISTANCE also give the derivative dz of z with respect to the
+// point, for distance estimation: init_dz() sets it for z_0 and step_dz()
+// advances it, given z before the step. distance() turns |z|^2 and |dz|^2
+// after step n (0-based) into a lower bound of the distance to the set.
+
+#include "Fractal/Kernel.h"
+#include <math.h>
+
+namespace {
+
+// |x| from the lane operations every lane type has
+template <typename V>
+static inline V abs_lanes(V x) {
+	return select(cmple(x, 0.0), V(0.0) - x, x);
+}
+
+// Milnor's bound for a connected, full set K of a polynomial of degree N:
+//
+//     dist >= sinh G / (2 e^G |grad G|)
+//
+// G being the Green's function of K, ln|Phi| for the Böttcher map Phi that
+// takes the complement of K to that of the unit disc. It only needs Phi to be
+// conformal there, so it holds for any N. With z ~ Phi^(N^k) after the
+// bailout, G = ln|z| / N^k and |grad G| = |dz| / (N^k |z|), and it becomes
+//
+//     dist >= |z| ln|z| / 2|dz| * (1 - e^-2G) / 2G
+//
+// The last factor is close to 1 everywhere but far outside the set, where
+// orbits escape within a few steps.
+static inline double green_distance(double norm, double dz_norm, int power, int k) {
+	const double ln_z = 0.5 * log(norm);
+	const double g = ln_z * exp(-k * log((double)power));
+	const double shrink = g > 0.0 ? -expm1(-2.0 * g) / (2.0 * g) : 1.0;
+	return 0.5 * sqrt(norm / dz_norm) * ln_z * shrink;
+}
+
+// z' = z^2 + c, z_0 = 0, c is the point
+struct Mandelbrot {
+	static constexpr bool INTERIOR_TEST = true; // main cardioid and period-2 bulb never escape
+	static constexpr int POWER = 2; // degree in z, for smooth escape times
+	static constexpr bool DISTANCE = true;
+
+	template <typename V>
+	static void init(V x, V y, const KernelParams&, V *zr, V *zi, V *cr, V *ci) {
+		*zr = 0.0;
+		*zi = 0.0;
+		*cr = x;
+		*ci = y;
+	}
+
+	template <typename V>
+	static void step(V *zr, V *zi, V cr, V ci) {
+		const V zr2 = *zr * *zr;
+		const V zi2 = *zi * *zi;
+		*zi = (*zr + *zr) * *zi + ci;
+		*zr = zr2 - zi2 + cr;
+	}
+
+	// dz' = 2 z dz + 1
+	template <typename V>
+	static void init_dz(V *dzr, V *dzi) {
+		*dzr = 0.0;
+		*dzi = 0.0;
+	}
+
+	template <typename V>
+	static void step_dz(V *dzr, V *dzi, V zr, V zi) {
+		const V r = zr * *dzr - zi * *dzi;
+		const V i = zr * *dzi + zi * *dzr;
+		*dzr = r + r + V(1.0);
+		*dzi = i + i;
+	}
+
+	// z_1 = c, so z_n+1 ~ Phi(c)^(2^n)
+	static double distance(double norm, double dz_norm, int n) {
+		return green_distance(norm, dz_norm, POWER, n);
+	}
+};
+
+// z' = z^2 + c, z_0 is the point, c is fixed by the params
+//
+// No distance estimates: green_distance() needs the Julia set to be
+// connected, which it is only for c in the Mandelbrot set, and the kernel
+// can't tell that for c close to the boundary.
+struct Julia {
+	static constexpr bool INTERIOR_TEST = false;
+	static constexpr int POWER = 2;
+	static constexpr bool DISTANCE = false;
+
+	template <typename V>
+	static void init(V x, V y, const KernelParams &params, V *zr, V *zi, V *cr, V *ci) {
+		*zr = x;
+		*zi = y;
+		*cr = params.julia_cr;
+		*ci = params.julia_ci;
+	}
+
+	template <typename V>
+	static void step(V *zr, V *zi, V cr, V ci) { Mandelbrot::step(zr, zi, cr, ci); }
+
+	template <typename V>
+	static void init_dz(V*, V*) {}
+
+	template <typename V>
+	static void step_dz(V*, V*, V, V) {}
+};
+
+// z' = (|re z| + i |im z|)^2 + c, z_0 = 0
+struct BurningShip {
+	static constexpr bool INTERIOR_TEST = false;
+	static constexpr int POWER = 2;
+	static constexpr bool DISTANCE = false; // not holomorphic
+
+	template <typename V>
+	static void init(V x, V y, const KernelParams &params, V *zr, V *zi, V *cr, V *ci) {
+		Mandelbrot::init(x, y, params, zr, zi, cr, ci);
+	}
+
+	template <typename V>
+	static void step(V *zr, V *zi, V cr, V ci) {
+		const V zr2 = *zr * *zr;
+		const V zi2 = *zi * *zi;
+		*zi = abs_lanes((*zr + *zr) * *zi) + ci;
+		*zr = zr2 - zi2 + cr;
+	}
+
+	template <typename V>
+	static void init_dz(V*, V*) {}
+
+	template <typename V>
+	static void step_dz(V*, V*, V, V) {}
+};
+
+// z' = z^N + c, z_0 = 0
+template <int N>
+struct Multibrot {
+	static_assert(N >= 3, "Multibrot<2> is Mandelbrot");
+	static constexpr bool INTERIOR_TEST = false;
+	static constexpr int POWER = N;
+	static constexpr bool DISTANCE = true;
+
+	template <typename V>
+	static void init(V x, V y, const KernelParams &params, V *zr, V *zi, V *cr, V *ci) {
+		Mandelbrot::init(x, y, params, zr, zi, cr, ci);
+	}
+
+	template <typename V>
+	static void step(V *zr, V *zi, V cr, V ci) {
+		V pr = *zr;
+		V pi = *zi;
+		for (int k = 1; k < N; k++) {
+			const V t = pr * *zr - pi * *zi;
+			pi = pr * *zi + pi * *zr;
+			pr = t;
+		}
+		*zr = pr + cr;
+		*zi = pi + ci;
+	}
+
+	// dz' = N z^(N-1) dz + 1
+	template <typename V>
+	static void init_dz(V *dzr, V *dzi) {
+		Mandelbrot::init_dz(dzr, dzi);
+	}
+
+	template <typename V>
+	static void step_dz(V *dzr, V *dzi, V zr, V zi) {
+		V pr = *dzr;
+		V pi = *dzi;
+		for (int k = 1; k < N; k++) {
+			const V t = pr * zr - pi * zi;
+			pi = pr * zi + pi * zr;
+			pr = t;
+		}
+		*dzr = V((double)N) * pr + V(1.0);
+		*dzi = V((double)N) * pi;
+	}
+
+	// Multibrot sets are connected as well, z_n+1 ~ Phi(c)^(N^n)
+	static double distance(double norm, double dz_norm, int n) {
+		return green_distance(norm, dz_norm, POWER, n);
+	}
+};
+
+// |z| > R. For all of the formulas above 2 is enough as long as |c| <= 2.
+template <int R>
+struct CircleBailout {
+	template <typename V>
+	static typename V::Mask escaped(V zr, V zi) {
+		return cmpgt(zr * zr + zi * zi, (double)R * R);
+	}
+};
+
+} // namespace
@@ -0,0 +1,194 @@
+#include "Fractal/Kernel.h"
+#include "Core/Vector.h"
+#include "Math/Utils.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Members used by the kernels live here, built without instruction set
+// flags, so every KernelXXX.cpp calls the same code.
+KernelStats &KernelStats::operator+=(const KernelStats &r) {
+	samples += r.samples;
+	interior_skipped += r.interior_skipped;
+	periodic += r.periodic;
+	periodic_iters_saved += r.periodic_iters_saved;
+	for (int i = 0; i < PERIOD_BUCKETS; i++)
+		period_hist[i] += r.period_hist[i];
+	glitched += r.glitched;
+	glitch_references += r.glitch_references;
+	series_skipped += r.series_skipped;
+	floatexp_iters += r.floatexp_iters;
+	subdivision_filled += r.subdivision_filled;
+	distance_filled += r.distance_filled;
+	supersampled += r.supersampled;
+	orbits_resumed += r.orbits_resumed;
+	resumed_iters_saved += r.resumed_iters_saved;
+	cancelled += r.cancelled;
+	return *this;
+}
+
+bool KernelParams::cancelled() const {
+	return cancel && cancel->load(std::memory_order_relaxed);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#define NG_KERNEL_X86
+#endif
+
+struct KernelVariant {
+	const char *name;
+	EscapeTimeFunc *escape_time;
+	EscapeTimeFunc *escape_time_float;
+	EscapeTimeDDFunc *escape_time_dd;
+	PerturbationFunc *perturbation;
+	bool (*supported)();
+};
+
+static bool always_supported() { return true; }
+#ifdef NG_KERNEL_X86
+static bool sse2_supported() { return __builtin_cpu_supports("sse2"); }
+static bool avx2_supported() { return __builtin_cpu_supports("avx2"); }
+static bool avx512_supported() { return __builtin_cpu_supports("avx512f"); }
+#endif
+
+// from worst to best
+static const KernelVariant variants[] = {
+	{"scalar", escape_time_scalar, escape_time_float_scalar, escape_time_dd_scalar, perturbation_scalar, always_supported},
+#ifdef NG_KERNEL_X86
+	{"sse2", escape_time_sse2, escape_time_float_sse2, escape_time_dd_sse2, perturbation_sse2, sse2_supported},
+	{"avx2", escape_time_avx2, escape_time_float_avx2, escape_time_dd_avx2, perturbation_avx2, avx2_supported},
+	{"avx512", escape_time_avx512, escape_time_float_avx512, escape_time_dd_avx512, perturbation_avx512, avx512_supported},
+#endif
+};
+
+static const KernelVariant *current = &variants[0];
+
+void init_kernels() {
+#ifdef NG_KERNEL_X86
+	__builtin_cpu_init();
+#endif
+	const int n = sizeof(variants)/sizeof(*variants);
+	int best = 0;
+	for (int i = 0; i < n; i++) {
+		if (variants[i].supported())
+			best = i;
+	}
+	current = &variants[best];
+
+	const char *forced = getenv("CPPMANDEL_KERNEL");
+	if (forced && *forced) {
+		int i = 0;
+		for (; i < n; i++) {
+			if (strcmp(variants[i].name, forced) == 0)
+				break;
+		}
+		if (i == n) {
+			printf("kernel: unknown CPPMANDEL_KERNEL=%s, ignoring\n", forced);
+		} else if (!variants[i].supported()) {
+			printf("kernel: %s is not supported by this CPU, ignoring CPPMANDEL_KERNEL\n", forced);
+		} else {
+			current = &variants[i];
+		}
+	}
+	printf("kernel: using %s variant\n", current->name);
+}
+
+const char *kernel_name() {
+	return current->name;
+}
+
+void escape_time(Slice<int> iters, Slice<float> smooth, Slice<const double> cr, Slice<const double> ci,
+	const KernelParams &params, KernelStats *stats, const OrbitState *state, Slice<float> dist)
+{
+	current->escape_time(iters, smooth, cr, ci, params, stats, state, dist);
+}
+
+// Float orbits drift off the double ones as rounding errors build up along
+// them, escape times past some 32 iterations are off by whole bands. Floats
+// only do this many, points still going after them start over in doubles.
+static constexpr int FLOAT_MAX_ITER = 32;
+
+void escape_time_float(Slice<int> iters, Slice<float> smooth, Slice<const double> cr, Slice<const double> ci,
+	const KernelParams &params, KernelStats *stats, const OrbitState *state, Slice<float> dist)
+{
+	const int n = iters.length;
+	// orbits are only ever saved by the double kernel, see below
+	if (n == 0 || (state && state->iter[0] != 0)) {
+		current->escape_time(iters, smooth, cr, ci, params, stats, state, dist);
+		return;
+	}
+
+	// the float kernel's own orbits tell finished points from running ones
+	KernelParams capped = params;
+	capped.max_iter = min(params.max_iter, FLOAT_MAX_ITER);
+	Vector<int> float_iter(n, 0);
+	Vector<double> float_zr(n), float_zi(n);
+	const OrbitState float_state = {float_iter.sub(), float_zr.sub(), float_zi.sub(), {}, {}};
+	current->escape_time_float(iters, smooth, cr, ci, capped, stats, &float_state, dist);
+	if (params.cancelled())
+		return;
+
+	// Unfinished points are left at 0, nothing of their float orbits is kept.
+	// Finished ones that didn't escape were found interior.
+	Vector<int> running;
+	for (int i = 0; i < n; i++) {
+		if (float_iter[i] != ORBIT_DONE) {
+			running.append(i);
+			continue;
+		}
+		if (state)
+			state->iter.data[i] = ORBIT_DONE;
+		if (iters[i] == capped.max_iter) {
+			iters[i] = params.max_iter;
+			if (smooth.length != 0)
+				smooth[i] = (float)params.max_iter;
+		}
+	}
+	if (running.length() == 0 || params.max_iter <= FLOAT_MAX_ITER)
+		return;
+
+	const int m = running.length();
+	Vector<double> rcr(m), rci(m);
+	Vector<int> out(m);
+	Vector<float> out_smooth(smooth.length != 0 ? m : 0);
+	Vector<float> out_dist(dist.length != 0 ? m : 0);
+	Vector<int> out_iter(state ? m : 0, 0);
+	Vector<double> out_zr(state ? m : 0), out_zi(state ? m : 0);
+	for (int i = 0; i < m; i++) {
+		rcr[i] = cr[running[i]];
+		rci[i] = ci[running[i]];
+	}
+	const OrbitState out_state = {out_iter.sub(), out_zr.sub(), out_zi.sub(), {}, {}};
+	KernelStats redo;
+	current->escape_time(out.sub(), out_smooth.sub(), rcr.sub(), rci.sub(), params, &redo,
+		state ? &out_state : nullptr, out_dist.sub());
+	redo.samples = 0; // counted by the float pass
+	if (stats)
+		*stats += redo;
+
+	for (int i = 0; i < m; i++) {
+		const int idx = running[i];
+		iters[idx] = out[i];
+		if (smooth.length != 0)
+			smooth[idx] = out_smooth[i];
+		if (dist.length != 0)
+			dist[idx] = out_dist[i];
+		if (state) {
+			state->iter.data[idx] = out_iter[i];
+			state->zr.data[idx] = out_zr[i];
+			state->zi.data[idx] = out_zi[i];
+		}
+	}
+}
+
+void escape_time_dd(Slice<int> iters, Slice<float> smooth, Slice<const double> dcr, Slice<const double> dci,
+	const ComplexDD &origin, const KernelParams &params, KernelStats *stats, const OrbitState *state)
+{
+	current->escape_time_dd(iters, smooth, dcr, dci, origin, params, stats, state);
+}
+
+void perturbation(Slice<int> iters, Slice<float> smooth, Slice<const double> dcr, Slice<const double> dci,
+	const ReferenceOrbit &ref, const KernelParams &params, KernelStats *stats, const OrbitState *state)
+{
+	current->perturbation(iters, smooth, dcr, dci, ref, params, stats, state);
+}
@@ -0,0 +1,203 @@
+#pragma once
+
+#include "Core/Slice.h"
+#include "Math/DoubleDouble.h"
+#include <atomic>
+#include <cstdint>
+
+// Periods are bucketed by powers of two: bucket i holds periods in [2^i, 2^(i+1)).
+static constexpr int PERIOD_BUCKETS = 16;
+
+// Work counters, filled by the kernel and accumulated per tile.
+struct KernelStats {
+	int64_t samples = 0;
+	int64_t interior_skipped = 0; // main cardioid and period-2 bulb hits
+	int64_t periodic = 0; // interior points detected by orbit periodicity
+	int64_t periodic_iters_saved = 0; // iterations not done thanks to periodicity
+	int64_t period_hist[PERIOD_BUCKETS] = {};
+	int64_t glitched = 0; // perturbation samples that lost precision
+	int64_t glitch_references = 0; // secondary references used to fix them
+	int64_t series_skipped = 0; // iterations skipped by series approximation
+	int64_t floatexp_iters = 0; // iterations done with extended exponent deltas
+	int64_t subdivision_filled = 0; // samples filled in by rectangle subdivision, never iterated
+	int64_t distance_filled = 0; // same, for rectangles farther from the set than their size
+	int64_t supersampled = 0; // pixels that got extra anti-aliasing samples
+	int64_t orbits_resumed = 0; // samples continued from a saved orbit, see OrbitState
+	int64_t resumed_iters_saved = 0; // iterations they didn't have to redo
+	int64_t cancelled = 0; // points left out, see KernelParams::cancel
+
+	// defined in Kernel.cpp, see KernelImpl.h
+	KernelStats &operator+=(const KernelStats &r);
+};
+
+// Iterated function, see Fractal/Formula.h. Only escape_time and
+// escape_time_float implement anything but MANDELBROT, other kernels ignore
+// the formula.
+enum class Formula {
+	MANDELBROT,
+	JULIA,
+	BURNING_SHIP,
+	MULTIBROT3,
+	MULTIBROT4,
+};
+
+struct KernelParams {
+	int max_iter = 0;
+	Formula formula = Formula::MANDELBROT;
+	double julia_cr = 0.0; // c of Formula::JULIA
+	double julia_ci = 0.0;
+
+	// Orbit is considered periodic (and the point interior) when z comes
+	// back within this distance of a previously saved z. Zero disables the
+	// check.
+	double periodicity_eps = 0.0;
+
+	// Perturbation only. A sample is glitched when |Z+dz|^2 < tol*|Z|^2
+	// (Pauldelbrot's criterion), i.e. the delta cancels the reference and
+	// its precision is gone. Glitched samples are reported as GLITCHED.
+	// Zero disables the check.
+	double glitch_tolerance = 0.0;
+
+	// Polled every CANCEL_BLOCK points, once it's set the kernel returns
+	// without touching the rest of them, their outputs are garbage then.
+	// Set by another thread when nobody needs the results anymore.
+	const std::atomic<bool> *cancel = nullptr;
+
+	bool cancelled() const;
+};
+
+// Points per cancellation check, see KernelParams::cancel.
+static constexpr int CANCEL_BLOCK = 256;
+
+// Iteration count of a glitched perturbation sample.
+static constexpr int GLITCHED = -1;
+
+// OrbitState::iter of points that are finished, escaped or found interior.
+static constexpr int ORBIT_DONE = -1;
+
+// Orbits of points, so that raising max_iter continues them from where they
+// stopped instead of starting over. On input, iter[i] is the number of
+// iterations already done, the same for every point of a call, and if it's
+// not 0, (zr[i], zi[i]) is z after them. For escape_time_dd these are the
+// high parts, the low ones are in zr_lo and zi_lo, for perturbation it's the
+// delta dz against the reference orbit.
+//
+// On output, points that neither escaped nor were found interior within
+// max_iter get iter[i] = max_iter and z there. Points whose orbit can't be
+// continued get 0 and have to start over, the rest ORBIT_DONE.
+struct OrbitState {
+	Slice<int> iter;
+	Slice<double> zr;
+	Slice<double> zi;
+	Slice<double> zr_lo; // escape_time_dd only
+	Slice<double> zi_lo;
+};
+
+// Series approximation of the first `iters` perturbation iterations:
+//
+//     dz_iters = A dc + B dc^2 + C dc^3
+//
+// Coefficients are complex, {real, imaginary}.
+struct SeriesSkip {
+	int iters = 0;
+	double a[2] = {0, 0};
+	double b[2] = {0, 0};
+	double c[2] = {0, 0};
+};
+
+// Reference orbit for the perturbation kernel: Z_0 = 0, Z_n+1 = Z_n^2 + C,
+// computed at high precision and rounded to doubles. Holds `length` values,
+// fewer than max_iter+1 if the reference point escaped.
+struct ReferenceOrbit {
+	const double *zr = nullptr;
+	const double *zi = nullptr;
+	int length = 0;
+	double cr = 0.0; // C rounded to double
+	double ci = 0.0;
+
+	// Deltas are in units of 2^delta_exp. Not zero only for views too deep
+	// for plain doubles.
+	int delta_exp = 0;
+
+	// Valid for the points of a particular call only, see Reference.
+	SeriesSkip series;
+};
+
+// Evaluates the escape time of every point (cr[i], ci[i]) and writes it to
+// iters[i]. The escape time is the 0-based iteration at which |z| > 2 first
+// happened, points that didn't escape in `max_iter` iterations get `max_iter`.
+// Points are processed in SIMD lanes, so pass as many of them as possible at
+// once. If `stats` is not null, counters are added to it.
+//
+// If `smooth` is not empty, smooth[i] gets the continuous escape time
+// iters[i] + 1 - log_p(log2 |z|), z being the first value past the bailout
+// and p the power of z in the formula. It varies smoothly across iteration
+// bands. Points that didn't escape get iters[i] there as well.
+//
+// If `state` is given, orbits continue from and are saved to it.
+//
+// If `dist` is not empty, dist[i] gets a lower bound of the distance from the
+// point to the set, estimated from the derivative of z tracked along the
+// orbit, see green_distance() in Formula.h. Points that didn't escape or
+// continued from `state` get 0, and so do all points of Formula::BURNING_SHIP,
+// which has no complex derivative, and Formula::JULIA, see Formula.h.
+void escape_time(Slice<int> iters, Slice<float> smooth, Slice<const double> cr, Slice<const double> ci,
+	const KernelParams &params, KernelStats *stats = nullptr, const OrbitState *state = nullptr,
+	Slice<float> dist = {});
+
+// Same as escape_time, iterated in floats at twice the lanes per register.
+// Only for views with pixels far larger than float resolution. Points still
+// going after 32 iterations, where float rounding starts to show, are iterated
+// again from the start with escape_time, and so are orbits continued from
+// `state`. Escape times agree with escape_time to within one iteration.
+void escape_time_float(Slice<int> iters, Slice<float> smooth, Slice<const double> cr, Slice<const double> ci,
+	const KernelParams &params, KernelStats *stats = nullptr, const OrbitState *state = nullptr,
+	Slice<float> dist = {});
+
+// Same as escape_time for views too deep for doubles, but not for
+// double-double: points are origin + (dcr[i], dci[i]), with the origin given
+// in double-double and iterated at that precision. Offsets are small, doubles
+// hold them to well below a pixel.
+void escape_time_dd(Slice<int> iters, Slice<float> smooth, Slice<const double> dcr, Slice<const double> dci,
+	const ComplexDD &origin, const KernelParams &params, KernelStats *stats = nullptr,
+	const OrbitState *state = nullptr);
+
+// Same as escape_time, but points are given as offsets (dcr[i], dci[i]) from
+// the reference point, for views deeper than double precision allows.
+// Cardioid and periodicity checks don't apply here, their math needs the
+// absolute coordinates. With glitch detection on, samples outliving the
+// reference orbit are GLITCHED as well, otherwise they continue with direct
+// iteration at double precision.
+void perturbation(Slice<int> iters, Slice<float> smooth, Slice<const double> dcr, Slice<const double> dci,
+	const ReferenceOrbit &ref, const KernelParams &params, KernelStats *stats = nullptr,
+	const OrbitState *state = nullptr);
+
+// Picks the best kernel variant for the current CPU, must be called once
+// before any worker calls escape_time. CPPMANDEL_KERNEL environment variable
+// overrides the choice (scalar, sse2, avx2, avx512).
+void init_kernels();
+const char *kernel_name();
+
+// Per instruction set variants, don't call directly.
+using EscapeTimeFunc = void(Slice<int>, Slice<float>, Slice<const double>, Slice<const double>, const KernelParams&,
+	KernelStats*, const OrbitState*, Slice<float>);
+EscapeTimeFunc escape_time_scalar;
+EscapeTimeFunc escape_time_sse2;
+EscapeTimeFunc escape_time_avx2;
+EscapeTimeFunc escape_time_avx512;
+EscapeTimeFunc escape_time_float_scalar;
+EscapeTimeFunc escape_time_float_sse2;
+EscapeTimeFunc escape_time_float_avx2;
+EscapeTimeFunc escape_time_float_avx512;
+using EscapeTimeDDFunc = void(Slice<int>, Slice<float>, Slice<const double>, Slice<const double>, const ComplexDD&,
+	const KernelParams&, KernelStats*, const OrbitState*);
+EscapeTimeDDFunc escape_time_dd_scalar;
+EscapeTimeDDFunc escape_time_dd_sse2;
+EscapeTimeDDFunc escape_time_dd_avx2;
+EscapeTimeDDFunc escape_time_dd_avx512;
+using PerturbationFunc = void(Slice<int>, Slice<float>, Slice<const double>, Slice<const double>, const ReferenceOrbit&,
+	const KernelParams&, KernelStats*, const OrbitState*);
+PerturbationFunc perturbation_scalar;
+PerturbationFunc perturbation_sse2;
+PerturbationFunc perturbation_avx2;
+PerturbationFunc perturbation_avx512;
@@ -0,0 +1,25 @@
+#include "Fractal/KernelImpl.h"
+
+void escape_time_avx2(Slice<int> iters, Slice<float> smooth, Slice<const double> cr, Slice<const double> ci,
+	const KernelParams &params, KernelStats *stats, const OrbitState *state, Slice<float> dist)
+{
+	escape_time_batch<F64x4>(iters, smooth, cr, ci, params, stats, state, dist);
+}
+
+void escape_time_float_avx2(Slice<int> iters, Slice<float> smooth, Slice<const double> cr, Slice<const double> ci,
+	const KernelParams &params, KernelStats *stats, const OrbitState *state, Slice<float> dist)
+{
+	escape_time_batch<F32x8>(iters, smooth, cr, ci, params, stats, state, dist);
+}
+
+void escape_time_dd_avx2(Slice<int> iters, Slice<float> smooth, Slice<const double> dcr, Slice<const double> dci,
+	const ComplexDD &origin, const KernelParams &params, KernelStats *stats, const OrbitState *state)
+{
+	escape_time_dd_batch<F64x4>(iters, smooth, dcr, dci, origin, params, stats, state);
+}
+
+void perturbation_avx2(Slice<int> iters, Slice<float> smooth, Slice<const double> dcr, Slice<const double> dci,
+	const ReferenceOrbit &ref, const KernelParams &params, KernelStats *stats, const OrbitState *state)
+{
+	perturbation_batch<F64x4>(iters, smooth, dcr, dci, ref, params, stats, state);
+}
@@ -0,0 +1,629 @@
+#pragma once
+
+// Kernel templates, included once by every KernelXXX.cpp file. Each of these
+// files is compiled with its own instruction set flags and instantiates the
+// templates with the widest lane type it has, so everything here must have
+// internal linkage. Inline members of types shared with the rest of the code
+// aren't, Slices are indexed through .data here for that reason.
+
+#include "Core/Defer.h"
+#include "Fractal/Formula.h"
+#include "Fractal/Kernel.h"
+#include "Fractal/SIMD.h"
+#include "Math/FloatExp.h"
+#include "Math/Utils.h"
+
+// Closed-form interior tests: the main cardioid and the period-2 bulb. Points
+// inside never escape, no need to iterate them.
+template <typename V>
+static typename V::Mask in_cardioid_or_bulb(V r, V i) {
+	const V i2 = i * i;
+	const V xq = r - 0.25;
+	const V q = xq * xq + i2;
+	const V xb = r + 1.0;
+	return mask_or(cmple(q * (q + xq), V(0.25) * i2), cmple(xb * xb + i2, 0.0625));
+}
+
+static inline int period_bucket(int period) {
+	int b = 0;
+	while (period >>= 1)
+		b++;
+	return min(b, PERIOD_BUCKETS-1);
+}
+
+// Writes escape times of the lanes to `iters` and, if `smooth` isn't null,
+// smooth escape times from |z|^2 just past the bailout, see escape_time().
+template <typename V>
+static void store_lanes(int *iters, float *smooth, V escaped_at, V norm, int max_iter, int power)
+{
+	double it[V::WIDTH];
+	escaped_at.store(it);
+	for (int i = 0; i < V::WIDTH; i++)
+		iters[i] = (int)it[i];
+	if (!smooth)
+		return;
+	double n[V::WIDTH];
+	norm.store(n);
+	const double inv_log_power = 1.0 / log2((double)power);
+	for (int i = 0; i < V::WIDTH; i++) {
+		const bool escaped = iters[i] >= 0 && iters[i] < max_iter;
+		smooth[i] = escaped ? (float)(it[i] + 1.0 - log2(0.5 * log2(n[i])) * inv_log_power) : (float)iters[i];
+	}
+}
+
+// The distance estimate only holds for |z| large enough, escaped lanes are
+// iterated on until |z|^2 passes this.
+static constexpr double DISTANCE_BAILOUT2 = 1e6;
+
+// Writes distance estimates of the lanes to `dist` from |z|^2 and |dz|^2 past
+// DISTANCE_BAILOUT2 and the step they got there at, 0 where they didn't, see
+// escape_time() and F::distance().
+template <typename V, typename F>
+static void store_distance(float *dist, V norm, V dz_norm, V at)
+{
+	double n[V::WIDTH], d[V::WIDTH], k[V::WIDTH];
+	norm.store(n);
+	dz_norm.store(d);
+	at.store(k);
+	for (int i = 0; i < V::WIDTH; i++)
+		dist[i] = n[i] > 0.0 && d[i] > 0.0 ? (float)F::distance(n[i], d[i], (int)k[i]) : 0.0f;
+}
+
+namespace {
+
+// OrbitState of one group of lanes, all null if there is none.
+struct LaneOrbits {
+	int *iter = nullptr;
+	double *zr = nullptr;
+	double *zi = nullptr;
+	double *zr_lo = nullptr;
+	double *zi_lo = nullptr;
+
+	// iterations already done, the same for all lanes
+	int start() const { return iter ? iter[0] : 0; }
+};
+
+} // namespace
+
+// Orbits saved with nothing done start at 0 and don't count.
+static inline void count_resumed(int start, int lanes, KernelStats *stats) {
+	if (start == 0)
+		return;
+	stats->orbits_resumed += lanes;
+	stats->resumed_iters_saved += (int64_t)lanes * start;
+}
+
+// Saves z of `unfinished` lanes at max_iter, the other lanes are ORBIT_DONE.
+template <typename V>
+static void save_orbits(const LaneOrbits &o, typename V::Mask unfinished, int max_iter, V zr, V zi)
+{
+	if (!o.iter)
+		return;
+	zr.store(o.zr);
+	zi.store(o.zi);
+	const int b = bits(unfinished);
+	for (int i = 0; i < V::WIDTH; i++)
+		o.iter[i] = (b >> i) & 1 ? max_iter : ORBIT_DONE;
+}
+
+// Only first `lanes` lanes are real points, the rest is padding.
+//
+// Periodicity check is Brent's cycle detection: z is saved at iterations 8,
+// 16, 32, ... and every following z is compared against the saved one, so
+// any period shorter than the current window is found within two windows.
+//
+// F is the formula and B the bailout policy, see Formula.h. With DIST the
+// derivative is tracked as well and distance estimates go to `dist`.
+template <typename V, typename F, typename B, bool DIST>
+static void escape_time_lanes(int *iters, float *smooth, float *dist, const double *x_in, const double *y_in,
+	const KernelParams &params, const LaneOrbits &orbits, int lanes, KernelStats *stats)
+{
+	const int max_iter = params.max_iter;
+	V zr, zi, cr, ci;
+	F::init(V::load(x_in), V::load(y_in), params, &zr, &zi, &cr, &ci);
+	const int start = orbits.start();
+	if (start > 0) {
+		zr = V::load(orbits.zr);
+		zi = V::load(orbits.zi);
+	}
+	V escaped_at = (double)max_iter;
+	V escaped_norm = 0.0;
+	V dzr, dzi;
+	V measured_norm = 0.0;
+	V measured_dz = 0.0;
+	V measured_at = 0.0;
+	auto measuring = mask_andnot(V::all_mask(), V::all_mask()); // escaped, short of DISTANCE_BAILOUT2
+	if constexpr (DIST)
+		F::init_dz(&dzr, &dzi);
+
+	const int lane_bits = (1 << lanes) - 1;
+	stats->samples += lanes;
+	count_resumed(start, lanes, stats);
+	auto active = V::all_mask();
+	if constexpr (F::INTERIOR_TEST) {
+		const auto interior = in_cardioid_or_bulb(cr, ci);
+		stats->interior_skipped += __builtin_popcount(bits(interior) & lane_bits);
+		active = mask_andnot(interior, active);
+	}
+
+	const bool check_period = params.periodicity_eps > 0.0;
+	const V eps2 = params.periodicity_eps * params.periodicity_eps;
+	V saved_zr = zr;
+	V saved_zi = zi;
+	int saved_i = start;
+	int next_save = start + 8;
+
+	for (int i = start; i < max_iter && any(DIST ? mask_or(active, measuring) : active); i++) {
+		if constexpr (DIST)
+			F::step_dz(&dzr, &dzi, zr, zi);
+		F::step(&zr, &zi, cr, ci);
+
+		// lanes that escaped earlier keep going, but their result is frozen
+		const auto escaped = mask_and(active, B::escaped(zr, zi));
+		escaped_at = select(escaped, V((double)i), escaped_at);
+		escaped_norm = select(escaped, zr * zr + zi * zi, escaped_norm);
+		active = mask_andnot(escaped, active);
+		if constexpr (DIST) {
+			const V norm = zr * zr + zi * zi;
+			measuring = mask_or(measuring, escaped);
+			const auto measured = mask_and(measuring, cmpgt(norm, DISTANCE_BAILOUT2));
+			measured_norm = select(measured, norm, measured_norm);
+			measured_dz = select(measured, dzr * dzr + dzi * dzi, measured_dz);
+			measured_at = select(measured, V((double)i), measured_at);
+			measuring = mask_andnot(measured, measuring);
+		}
+
+		if (!check_period)
+			continue;
+		const V dr = zr - saved_zr;
+		const V di = zi - saved_zi;
+		const auto periodic = mask_and(active, cmple(dr * dr + di * di, eps2));
+		if (any(periodic)) {
+			const int n = __builtin_popcount(bits(periodic) & lane_bits);
+			stats->periodic += n;
+			stats->periodic_iters_saved += (int64_t)n * (max_iter - i - 1);
+			stats->period_hist[period_bucket(i - saved_i)] += n;
+			active = mask_andnot(periodic, active);
+		}
+		if (i == next_save) {
+			saved_zr = zr;
+			saved_zi = zi;
+			saved_i = i;
+			next_save *= 2;
+		}
+	}
+
+	store_lanes(iters, smooth, escaped_at, escaped_norm, max_iter, F::POWER);
+	if constexpr (DIST) {
+		// the derivative isn't saved with the orbit
+		if (start == 0)
+			store_distance<V, F>(dist, measured_norm, measured_dz, measured_at);
+		else
+			for (int i = 0; i < V::WIDTH; i++)
+				dist[i] = 0.0f;
+	}
+	save_orbits(orbits, active, max_iter, zr, zi);
+}
+
+// escape_time_lanes at double-double precision, c = origin + dc. The closed
+// form interior test is done in doubles, so it is shrunk a little to stay on
+// the safe side of the boundary, where doubles can't tell pixels apart.
+template <typename V>
+static void escape_time_dd_lanes(int *iters, float *smooth, const double *dcr_in, const double *dci_in,
+	const ComplexDD &origin, const KernelParams &params, const LaneOrbits &orbits, int lanes, KernelStats *stats)
+{
+	const int max_iter = params.max_iter;
+	const ComplexDDT<V> c = {
+		DoubleDoubleT<V>{V(origin.re.hi), V(origin.re.lo)} + V::load(dcr_in),
+		DoubleDoubleT<V>{V(origin.im.hi), V(origin.im.lo)} + V::load(dci_in),
+	};
+	ComplexDDT<V> z = {{0.0, 0.0}, {0.0, 0.0}};
+	const int start = orbits.start();
+	if (start > 0) {
+		z.re = {V::load(orbits.zr), V::load(orbits.zr_lo)};
+		z.im = {V::load(orbits.zi), V::load(orbits.zi_lo)};
+	}
+	V escaped_at = (double)max_iter;
+	V escaped_norm = 0.0;
+
+	const V i2 = c.im.hi * c.im.hi;
+	const V xq = c.re.hi - 0.25;
+	const V q = xq * xq + i2;
+	const V xb = c.re.hi + 1.0;
+	const auto interior = mask_or(
+		cmple(q * (q + xq), V(0.25 * (1.0 - 1e-12)) * i2),
+		cmple(xb * xb + i2, 0.0625 * (1.0 - 1e-12)));
+	const int lane_bits = (1 << lanes) - 1;
+	stats->samples += lanes;
+	stats->interior_skipped += __builtin_popcount(bits(interior) & lane_bits);
+	count_resumed(start, lanes, stats);
+
+	const bool check_period = params.periodicity_eps > 0.0;
+	const V eps2 = params.periodicity_eps * params.periodicity_eps;
+	ComplexDDT<V> saved = z;
+	int saved_i = start;
+	int next_save = start + 8;
+
+	auto active = mask_andnot(interior, V::all_mask());
+	for (int i = start; i < max_iter && any(active); i++) {
+		z = sqr(z) + c;
+
+		const V norm = norm_hi(z);
+		const auto escaped = mask_and(active, cmpgt(norm, 4.0));
+		escaped_at = select(escaped, V((double)i), escaped_at);
+		escaped_norm = select(escaped, norm, escaped_norm);
+		active = mask_andnot(escaped, active);
+
+		if (!check_period)
+			continue;
+		// close values, the high parts cancel exactly
+		const V dr = (z.re.hi - saved.re.hi) + (z.re.lo - saved.re.lo);
+		const V di = (z.im.hi - saved.im.hi) + (z.im.lo - saved.im.lo);
+		const auto periodic = mask_and(active, cmple(dr * dr + di * di, eps2));
+		if (any(periodic)) {
+			const int n = __builtin_popcount(bits(periodic) & lane_bits);
+			stats->periodic += n;
+			stats->periodic_iters_saved += (int64_t)n * (max_iter - i - 1);
+			stats->period_hist[period_bucket(i - saved_i)] += n;
+			active = mask_andnot(periodic, active);
+		}
+		if (i == next_save) {
+			saved = z;
+			saved_i = i;
+			next_save *= 2;
+		}
+	}
+
+	store_lanes(iters, smooth, escaped_at, escaped_norm, max_iter, 2);
+	save_orbits(orbits, active, max_iter, z.re.hi, z.im.hi);
+	if (orbits.iter) {
+		z.re.lo.store(orbits.zr_lo);
+		z.im.lo.store(orbits.zi_lo);
+	}
+}
+
+// Deltas leave the extended exponent phase once they are this large, far
+// enough from the double underflow threshold for full mantissa precision.
+static constexpr int64_t FLOATEXP_EXIT = -960;
+
+// Beginning of the perturbation orbit for deltas too small for doubles, dz and
+// dc are in units of 2^ref.delta_exp. dz^2 underflows against 2 Z dz anyway,
+// so the iteration is just dz' = 2 Z dz + dc at first, done with an extended
+// exponent until dz is large enough for doubles. Returns the iteration it
+// stopped at, dz is scaled to plain doubles.
+//
+// dc stays in units of 2^ref.delta_exp only until then: the caller scales it
+// to plain doubles as well, denormal or zero where it's below 2^-1022. That
+// is accepted. The rounding error of a denormal is at most 2^-1075, while dz
+// is past 2^FLOATEXP_EXIT by then, so it adds under 2^-115 of dz per
+// iteration, far below the rounding of dz itself. It only shows if dz later
+// shrinks back towards dc, and then dz loses its own precision in doubles as
+// well.
+template <typename V>
+static int perturbation_floatexp(V *dzr, V *dzi, const V &dcr, const V &dci, const ReferenceOrbit &ref,
+	int i, int end)
+{
+	FloatExpLanes<V> zr = {*dzr, ref.delta_exp};
+	FloatExpLanes<V> zi = {*dzi, ref.delta_exp};
+	const FloatExpLanes<V> cr = {dcr, ref.delta_exp};
+	const FloatExpLanes<V> ci = {dci, ref.delta_exp};
+	for (; i < end; i++) {
+		if (i % 8 == 0) {
+			normalize(&zr);
+			normalize(&zi);
+			if (max(zr.e, zi.e) > FLOATEXP_EXIT)
+				break;
+		}
+		const V tr = V(ref.zr[i] * 2.0);
+		const V ti = V(ref.zi[i] * 2.0);
+		const FloatExpLanes<V> nzr = tr * zr - ti * zi + cr;
+		zi = tr * zi + ti * zr + ci;
+		zr = nzr;
+	}
+	*dzr = to_lanes(zr);
+	*dzi = to_lanes(zi);
+	return i;
+}
+
+// Perturbation: every point is c = C + dc, where C is the reference point.
+// The orbit is tracked as a delta dz against the reference orbit Z:
+//
+//     dz' = 2 Z dz + dz^2 + dc = (2 Z + dz) dz + dc
+//
+// which stays accurate in doubles even when c itself isn't representable.
+// All lanes advance in lockstep, so Z_n is the same for all of them. If the
+// reference escapes before the point does, the point is glitched, or if
+// glitch detection is off, the rest of the orbit is iterated directly as
+// z = Z + dz, c = C + dc.
+//
+// Only orbits that stop in the reference phase with dz in plain doubles can
+// be saved, others start over. Saved dz are plain doubles as well. Series
+// approximation reaching past the saved orbits is used instead of them.
+template <typename V>
+static void perturbation_lanes(int *iters, float *smooth, const double *dcr_in, const double *dci_in,
+	const ReferenceOrbit &ref, const KernelParams &params, const LaneOrbits &orbits, int lanes, KernelStats *stats)
+{
+	const int max_iter = params.max_iter;
+	V dcr = V::load(dcr_in);
+	V dci = V::load(dci_in);
+	V dzr = 0.0;
+	V dzi = 0.0;
+	V escaped_at = (double)max_iter;
+	V escaped_norm = 0.0;
+	const int lane_bits = (1 << lanes) - 1;
+	stats->samples += lanes;
+
+	int i = 0;
+	bool resumed = false;
+	const int start = orbits.start();
+	const SeriesSkip &series = ref.series;
+	if (series.iters > start && series.iters <= max_iter) {
+		// Horner's scheme: dz = ((C dc + B) dc + A) dc
+		const V tr = V(series.c[0]) * dcr - V(series.c[1]) * dci + series.b[0];
+		const V ti = V(series.c[0]) * dci + V(series.c[1]) * dcr + series.b[1];
+		const V ur = tr * dcr - ti * dci + series.a[0];
+		const V ui = tr * dci + ti * dcr + series.a[1];
+		dzr = ur * dcr - ui * dci;
+		dzi = ur * dci + ui * dcr;
+		i = series.iters;
+		stats->series_skipped += (int64_t)lanes * i;
+	} else if (start > 0) {
+		NG_ASSERT(start < ref.length);
+		dzr = V::load(orbits.zr);
+		dzi = V::load(orbits.zi);
+		i = start;
+		resumed = true;
+		count_resumed(start, lanes, stats);
+	}
+
+	const bool check_glitch = params.glitch_tolerance > 0.0;
+	auto active = V::all_mask();
+	const int ref_iter = min(max_iter, ref.length - 1);
+	bool resumable = true; // dz can be saved at max_iter
+	if (ref.delta_exp != 0) {
+		if (!resumed) {
+			const int first = i;
+			i = perturbation_floatexp(&dzr, &dzi, dcr, dci, ref, i, ref_iter);
+			stats->floatexp_iters += (int64_t)lanes * (i - first);
+			resumable = i < ref_iter;
+		}
+		// dc may end up denormal, see perturbation_floatexp()
+		const V scale = exp2i(ref.delta_exp);
+		dcr = dcr * scale;
+		dci = dci * scale;
+	}
+	for (; i < ref_iter && any(active); i++) {
+		const V tr = V(ref.zr[i] * 2.0) + dzr;
+		const V ti = V(ref.zi[i] * 2.0) + dzi;
+		const V ndzr = tr * dzr - ti * dzi + dcr;
+		dzi = tr * dzi + ti * dzr + dci;
+		dzr = ndzr;
+
+		const double Zr = ref.zr[i+1];
+		const double Zi = ref.zi[i+1];
+		const V zr = V(Zr) + dzr;
+		const V zi = V(Zi) + dzi;
+		const V z2 = zr * zr + zi * zi;
+		const auto escaped = mask_and(active, cmpgt(z2, 4.0));
+		escaped_at = select(escaped, V((double)i), escaped_at);
+		escaped_norm = select(escaped, z2, escaped_norm);
+		active = mask_andnot(escaped, active);
+
+		if (check_glitch) {
+			const auto glitch = mask_and(active, cmple(z2, params.glitch_tolerance * (Zr * Zr + Zi * Zi)));
+			if (any(glitch)) {
+				stats->glitched += __builtin_popcount(bits(glitch) & lane_bits);
+				escaped_at = select(glitch, V((double)GLITCHED), escaped_at);
+				active = mask_andnot(glitch, active);
+			}
+		}
+	}
+
+	if (check_glitch && i < max_iter && any(active)) {
+		stats->glitched += __builtin_popcount(bits(active) & lane_bits);
+		escaped_at = select(active, V((double)GLITCHED), escaped_at);
+	} else if (i < max_iter && any(active)) {
+		resumable = false;
+		const V cr = V(ref.cr) + dcr;
+		const V ci = V(ref.ci) + dci;
+		V zr = V(ref.zr[i]) + dzr;
+		V zi = V(ref.zi[i]) + dzi;
+		for (; i < max_iter && any(active); i++) {
+			const V zr2 = zr * zr;
+			const V zi2 = zi * zi;
+			zi = (zr + zr) * zi + ci;
+			zr = zr2 - zi2 + cr;
+
+			const V z2 = zr * zr + zi * zi;
+			const auto escaped = mask_and(active, cmpgt(z2, 4.0));
+			escaped_at = select(escaped, V((double)i), escaped_at);
+			escaped_norm = select(escaped, z2, escaped_norm);
+			active = mask_andnot(escaped, active);
+		}
+	}
+
+	store_lanes(iters, smooth, escaped_at, escaped_norm, max_iter, 2);
+	if (orbits.iter) {
+		dzr.store(orbits.zr);
+		dzi.store(orbits.zi);
+		for (int l = 0; l < V::WIDTH; l++) {
+			if (iters[l] == GLITCHED)
+				orbits.iter[l] = 0;
+			else if (iters[l] < max_iter)
+				orbits.iter[l] = ORBIT_DONE;
+			else
+				orbits.iter[l] = resumable ? max_iter : 0;
+		}
+	}
+}
+
+// Splits points into groups of V::WIDTH and calls `lanes_func` for each
+// group. Tail group is padded with a copy of the last point. `smooth` and
+// `dist` are either empty or as long as `iters`, lanes_func gets null in the
+// former case. Same for `state`, its slices have to be as long as `iters` and
+// lanes_func gets them as LaneOrbits. Stops early once `params` are cancelled.
+template <typename V, typename F>
+static void run_lanes(Slice<int> iters, Slice<float> smooth, Slice<float> dist, Slice<const double> x,
+	Slice<const double> y, const KernelParams &params, KernelStats *stats, const OrbitState *state,
+	F &&lanes_func)
+{
+	NG_ASSERT(iters.length == x.length && iters.length == y.length);
+	NG_ASSERT(smooth.length == 0 || smooth.length == iters.length);
+	NG_ASSERT(dist.length == 0 || dist.length == iters.length);
+	KernelStats local;
+	DEFER { if (stats) *stats += local; };
+
+	const int n = iters.length;
+	const bool dd = state && state->zr_lo.length != 0;
+	if (state) {
+		NG_ASSERT(state->iter.length == n && state->zr.length == n && state->zi.length == n);
+		NG_ASSERT(!dd || (state->zr_lo.length == n && state->zi_lo.length == n));
+		for (int i = 1; i < n; i++)
+			NG_ASSERT(state->iter.data[i] == state->iter.data[0]);
+	}
+	const auto lane_orbits = [&](int i) {
+		LaneOrbits o;
+		if (state) {
+			o.iter = state->iter.data + i;
+			o.zr = state->zr.data + i;
+			o.zi = state->zi.data + i;
+			if (dd) {
+				o.zr_lo = state->zr_lo.data + i;
+				o.zi_lo = state->zi_lo.data + i;
+			}
+		}
+		return o;
+	};
+
+	const int full = n - n % V::WIDTH;
+	float *const smooth_data = smooth.length != 0 ? smooth.data : nullptr;
+	float *const dist_data = dist.length != 0 ? dist.data : nullptr;
+	static_assert(CANCEL_BLOCK % V::WIDTH == 0, "blocks are whole lane groups");
+	for (int i = 0; i < full; i += V::WIDTH) {
+		if (i % CANCEL_BLOCK == 0 && params.cancelled()) {
+			local.cancelled += n - i;
+			return;
+		}
+		lanes_func(iters.data + i, smooth_data ? smooth_data + i : nullptr, dist_data ? dist_data + i : nullptr,
+			x.data + i, y.data + i, lane_orbits(i), V::WIDTH, &local);
+	}
+	if (full == n)
+		return;
+	if (params.cancelled()) {
+		local.cancelled += n - full;
+		return;
+	}
+
+	double tx[V::WIDTH], ty[V::WIDTH];
+	int tout[V::WIDTH];
+	float tsmooth[V::WIDTH];
+	float tdist[V::WIDTH];
+	int titer[V::WIDTH];
+	double tzr[V::WIDTH], tzi[V::WIDTH], tzr_lo[V::WIDTH], tzi_lo[V::WIDTH];
+	const LaneOrbits src = lane_orbits(0);
+	for (int i = 0; i < V::WIDTH; i++) {
+		const int idx = min(full + i, n - 1);
+		tx[i] = x.data[idx];
+		ty[i] = y.data[idx];
+		if (state) {
+			titer[i] = src.iter[idx];
+			tzr[i] = src.zr[idx];
+			tzi[i] = src.zi[idx];
+			if (dd) {
+				tzr_lo[i] = src.zr_lo[idx];
+				tzi_lo[i] = src.zi_lo[idx];
+			}
+		}
+	}
+	LaneOrbits tail;
+	if (state)
+		tail = {titer, tzr, tzi, dd ? tzr_lo : nullptr, dd ? tzi_lo : nullptr};
+	lanes_func(tout, smooth_data ? tsmooth : nullptr, dist_data ? tdist : nullptr, tx, ty, tail, n - full, &local);
+	for (int i = full; i < n; i++) {
+		iters.data[i] = tout[i - full];
+		if (smooth_data)
+			smooth_data[i] = tsmooth[i - full];
+		if (dist_data)
+			dist_data[i] = tdist[i - full];
+		if (state) {
+			src.iter[i] = titer[i - full];
+			src.zr[i] = tzr[i - full];
+			src.zi[i] = tzi[i - full];
+			if (dd) {
+				src.zr_lo[i] = tzr_lo[i - full];
+				src.zi_lo[i] = tzi_lo[i - full];
+			}
+		}
+	}
+}
+
+// Picks whether to track the derivative once per batch, formulas without one
+// fill `dist` with zeroes.
+template <typename V, typename F, typename B = CircleBailout<2>>
+static void escape_time_formula_batch(Slice<int> iters, Slice<float> smooth, Slice<const double> cr,
+	Slice<const double> ci, const KernelParams &params, KernelStats *stats, const OrbitState *state,
+	Slice<float> dist)
+{
+	if (!F::DISTANCE) {
+		for (int i = 0; i < dist.length; i++)
+			dist.data[i] = 0.0f;
+		dist = {};
+	}
+	run_lanes<V>(iters, smooth, dist, cr, ci, params, stats, state, [&](int *out, float *sm, float *d, const double *x,
+		const double *y, const LaneOrbits &orbits, int lanes, KernelStats *st)
+	{
+		if (d)
+			escape_time_lanes<V, F, B, F::DISTANCE>(out, sm, d, x, y, params, orbits, lanes, st);
+		else
+			escape_time_lanes<V, F, B, false>(out, sm, d, x, y, params, orbits, lanes, st);
+	});
+}
+
+// Picks the formula once per batch.
+template <typename V>
+static void escape_time_batch(Slice<int> iters, Slice<float> smooth, Slice<const double> cr,
+	Slice<const double> ci, const KernelParams &params, KernelStats *stats, const OrbitState *state,
+	Slice<float> dist)
+{
+	switch (params.formula) {
+	case Formula::MANDELBROT:
+		escape_time_formula_batch<V, Mandelbrot>(iters, smooth, cr, ci, params, stats, state, dist);
+		break;
+	case Formula::JULIA:
+		escape_time_formula_batch<V, Julia>(iters, smooth, cr, ci, params, stats, state, dist);
+		break;
+	case Formula::BURNING_SHIP:
+		escape_time_formula_batch<V, BurningShip>(iters, smooth, cr, ci, params, stats, state, dist);
+		break;
+	case Formula::MULTIBROT3:
+		escape_time_formula_batch<V, Multibrot<3>>(iters, smooth, cr, ci, params, stats, state, dist);
+		break;
+	case Formula::MULTIBROT4:
+		escape_time_formula_batch<V, Multibrot<4>>(iters, smooth, cr, ci, params, stats, state, dist);
+		break;
+	}
+}
+
+template <typename V>
+static void escape_time_dd_batch(Slice<int> iters, Slice<float> smooth, Slice<const double> dcr,
+	Slice<const double> dci, const ComplexDD &origin, const KernelParams &params, KernelStats *stats,
+	const OrbitState *state)
+{
+	run_lanes<V>(iters, smooth, {}, dcr, dci, params, stats, state, [&](int *out, float *sm, float*, const double *x,
+		const double *y, const LaneOrbits &orbits, int lanes, KernelStats *st)
+	{
+		escape_time_dd_lanes<V>(out, sm, x, y, origin, params, orbits, lanes, st);
+	});
+}
+
+template <typename V>
+static void perturbation_batch(Slice<int> iters, Slice<float> smooth, Slice<const double> dcr,
+	Slice<const double> dci, const ReferenceOrbit &ref, const KernelParams &params, KernelStats *stats,
+	const OrbitState *state)
+{
+	run_lanes<V>(iters, smooth, {}, dcr, dci, params, stats, state, [&](int *out, float *sm, float*, const double *x,
+		const double *y, const LaneOrbits &orbits, int lanes, KernelStats *st)
+	{
+		perturbation_lanes<V>(out, sm, x, y, ref, params, orbits, lanes, st);
+	});
+}
@@ -0,0 +1,108 @@
+#include "Fractal/Perturbation.h"
+#include <cmath>
+
+// Extends `series` to the length of the orbit, continuing from its last terms.
+static void compute_series(Vector<SeriesTerms> *series, const Vector<double> &zr, const Vector<double> &zi) {
+	// A' = 2ZA + 1, B' = 2ZB + A^2, C' = 2ZC + 2AB
+	const int first = series->length();
+	series->resize(zr.length());
+	SeriesTerms t = {{0, 0}, {0, 0}, {0, 0}};
+	if (first == 0)
+		(*series)[0] = t;
+	else
+		t = (*series)[first-1];
+	for (int n = first == 0 ? 0 : first-1; n < zr.length()-1; n++) {
+		const double z2r = zr[n] * 2.0;
+		const double z2i = zi[n] * 2.0;
+		SeriesTerms next;
+		next.a[0] = z2r * t.a[0] - z2i * t.a[1] + 1.0;
+		next.a[1] = z2r * t.a[1] + z2i * t.a[0];
+		next.b[0] = z2r * t.b[0] - z2i * t.b[1] + t.a[0] * t.a[0] - t.a[1] * t.a[1];
+		next.b[1] = z2r * t.b[1] + z2i * t.b[0] + 2.0 * t.a[0] * t.a[1];
+		next.c[0] = z2r * t.c[0] - z2i * t.c[1] + 2.0 * (t.a[0] * t.b[0] - t.a[1] * t.b[1]);
+		next.c[1] = z2r * t.c[1] + z2i * t.c[0] + 2.0 * (t.a[0] * t.b[1] + t.a[1] * t.b[0]);
+		t = next;
+		(*series)[n+1] = t;
+	}
+}
+
+void Reference::compute(const HPVec2 &c, int max_iter, int delta_exp) {
+	this->c = c;
+	this->delta_exp = delta_exp;
+	z = HPVec2(0, 0);
+	this->max_iter = 0;
+	zr.clear();
+	zi.clear();
+	series.clear();
+	zr.append(0.0);
+	zi.append(0.0);
+	extend(max_iter);
+}
+
+void Reference::extend(int max_iter) {
+	if (max_iter <= this->max_iter || escaped())
+		return;
+	zr.reserve(max_iter+1);
+	zi.reserve(max_iter+1);
+
+	HPReal x = z.x;
+	HPReal y = z.y;
+	for (int i = this->max_iter; i < max_iter; i++) {
+		const HPReal x2 = sqr(x);
+		const HPReal y2 = sqr(y);
+		y = mul_add(x + x, y, c.y);
+		x = x2 - y2 + c.x;
+
+		const double dx = (double)x;
+		const double dy = (double)y;
+		zr.append(dx);
+		zi.append(dy);
+		if (dx * dx + dy * dy > 4.0)
+			break;
+	}
+	z = HPVec2(x, y);
+	this->max_iter = max_iter;
+	compute_series(&series, zr, zi);
+}
+
+int Reference::series_skip(int max_iter, double radius, double tolerance) const {
+	// skipping up to the last Z or the limit leaves nothing for the kernel
+	// to work with
+	const int last = min(series.length()-1, max_iter);
+	int n = 0;
+	for (int i = 1; i < last; i++) {
+		const SeriesTerms &t = series[i];
+		const double a = std::hypot(t.a[0], t.a[1]) * radius;
+		const double c = std::hypot(t.c[0], t.c[1]) * exp2i(2 * (int64_t)delta_exp) * radius * radius * radius;
+		if (!std::isfinite(a) || !(c <= tolerance * a)) // also stops on nan
+			break;
+		n = i;
+	}
+	return n;
+}
+
+ReferenceOrbit Reference::orbit(int max_iter, double radius, double tolerance) const {
+	ReferenceOrbit o;
+	o.zr = zr.data();
+	o.zi = zi.data();
+	o.length = zr.length();
+	o.cr = (double)c.x;
+	o.ci = (double)c.y;
+	o.delta_exp = delta_exp;
+	if (radius > 0.0 && tolerance > 0.0) {
+		const int n = series_skip(max_iter, radius, tolerance);
+		if (n > 0) {
+			// dz / 2^k = A dc / 2^k + B 2^k (dc / 2^k)^2 + C 2^2k (dc / 2^k)^3
+			const SeriesTerms &t = series[n];
+			const double b_scale = exp2i(delta_exp);
+			const double c_scale = exp2i(2 * (int64_t)delta_exp);
+			o.series.iters = n;
+			for (int i = 0; i < 2; i++) {
+				o.series.a[i] = t.a[i];
+				o.series.b[i] = t.b[i] * b_scale;
+				o.series.c[i] = t.c[i] * c_scale;
+			}
+		}
+	}
+	return o;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "Core/Vector.h"
+#include "Fractal/Kernel.h"
+#include "Math/BigFixed.h"
+#include "Math/FloatExp.h"
+
+// Precision used for view coordinates and reference orbits of deep views.
+// 47 fraction limbs, 1504 bits, resolve coordinates down to about 1e-452.
+using HPReal = BigFixed<48>;
+
+struct HPVec2 {
+	HPReal x, y;
+
+	HPVec2() = default;
+	HPVec2(HPReal x, HPReal y): x(x), y(y) {}
+};
+
+// Series approximation coefficients after n iterations, see SeriesSkip.
+struct SeriesTerms {
+	double a[2];
+	double b[2];
+	double c[2];
+};
+
+// High precision reference point C, its orbit rounded to doubles and the
+// series approximation table built from the orbit.
+struct Reference {
+	HPVec2 c;
+	Vector<double> zr;
+	Vector<double> zi;
+	Vector<SeriesTerms> series;
+	int delta_exp = 0; // deltas from C are in units of 2^delta_exp
+	int max_iter = 0; // iterations computed for, fewer are stored if the orbit escaped
+	HPVec2 z; // last Z, for extend()
+
+	// Iterates Z_n+1 = Z_n^2 + C at HPReal precision until it escapes or
+	// reaches max_iter iterations.
+	void compute(const HPVec2 &c, int max_iter, int delta_exp = 0);
+
+	// Continues the orbit up to `max_iter` iterations. Reallocates the
+	// arrays, orbits handed out before don't survive it.
+	void extend(int max_iter);
+
+	// True if the orbit escaped, no limit needs more of it then.
+	bool escaped() const {
+		const int n = zr.length()-1;
+		return n >= 0 && zr[n] * zr[n] + zi[n] * zi[n] > 4.0;
+	}
+
+	// Orbit for the kernel. If `radius` is not zero, orbit's series skip is
+	// set up for points within `radius` of C: as many iterations as possible
+	// while the cubic term stays below `tolerance` relative to the linear
+	// one, and fewer than `max_iter`, the kernel's limit. Like the deltas,
+	// `radius` and the coefficients are in units of 2^delta_exp.
+	ReferenceOrbit orbit(int max_iter = 0, double radius = 0.0, double tolerance = 0.0) const;
+	int series_skip(int max_iter, double radius, double tolerance) const;
+};
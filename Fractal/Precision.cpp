@@ -0,0 +1,46 @@
+#include "Fractal/Precision.h"
+
+// Float is used only while pixels are at least this large relative to the
+// largest coordinates that matter, |c| <= 2 (everything else escapes right
+// away). It doesn't depend on the view centre, so panning never reaches
+// coordinates the view's precision can't handle.
+static constexpr double FLOAT_THRESHOLD = 1.0 / (1 << 11);
+static constexpr double MAX_COORDINATE = 2.0;
+
+// Pixels smaller than this, relative to the coordinates, can't be rendered in
+// plain doubles and need double-double.
+static constexpr double DOUBLE_DOUBLE_THRESHOLD = 1.0 / (1ll << 40);
+
+// Same for double-double, 106 bits of mantissa minus some room for the
+// iteration error. Past this views switch to perturbation.
+static constexpr double PERTURBATION_THRESHOLD = DOUBLE_DOUBLE_THRESHOLD / (1ll << 50);
+
+// Coordinates smaller than this don't buy any precision: orbits go through
+// |z| around 1 wherever the view is, and that's where the bits run out. Views
+// centred near 0 are judged as if they were this far out.
+static constexpr double MIN_MAGNITUDE = 1.0;
+
+Precision choose_precision(const FloatExp &pixel, double center) {
+	if (pixel.e < FLOATEXP_THRESHOLD)
+		return Precision::PERTURBATION_FLOATEXP;
+	const double p = (double)pixel;
+	const double magnitude = center > MIN_MAGNITUDE ? center : MIN_MAGNITUDE;
+	if (p < magnitude * PERTURBATION_THRESHOLD)
+		return Precision::PERTURBATION;
+	if (p < magnitude * DOUBLE_DOUBLE_THRESHOLD)
+		return Precision::DOUBLE_DOUBLE;
+	if (p < MAX_COORDINATE * FLOAT_THRESHOLD)
+		return Precision::DOUBLE;
+	return Precision::FLOAT;
+}
+
+const char *precision_name(Precision p) {
+	switch (p) {
+	case Precision::FLOAT: return "float";
+	case Precision::DOUBLE: return "double";
+	case Precision::DOUBLE_DOUBLE: return "double-double";
+	case Precision::PERTURBATION: return "perturbation";
+	case Precision::PERTURBATION_FLOATEXP: return "perturbation+floatexp";
+	}
+	return "unknown";
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "Math/FloatExp.h"
+
+// Number formats views are rendered with, from the cheapest one. Each is
+// picked only when the cheaper ones can't resolve the view's pixels.
+enum class Precision {
+	FLOAT,
+	DOUBLE,
+	DOUBLE_DOUBLE, // coordinates are relative to the view origin
+	PERTURBATION, // coordinates are relative to the reference point
+	PERTURBATION_FLOATEXP, // same, deltas are scaled by 2^delta_exp
+};
+
+// Views with pixels smaller than 2^FLOATEXP_THRESHOLD have perturbation
+// deltas too close to the double underflow and scale them by 2^delta_exp.
+static inline constexpr int FLOATEXP_THRESHOLD = -960;
+
+// Cheapest precision that still tells apart pixels of size `pixel` at
+// coordinates of magnitude `center`, taken as at least 1.
+Precision choose_precision(const FloatExp &pixel, double center);
+const char *precision_name(Precision p);
@@ -0,0 +1,323 @@
+#pragma once
+
+#include <stdint.h>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+//------------------------------------------------------------------------------
+// Lane types for the escape-time kernels. Each type packs `WIDTH` doubles and
+// exposes the same small set of operations, so the kernel is written once as
+// a template. Every lane type has a matching `Mask` type, masks are combined
+// with mask_and/mask_or/mask_andnot and tested with any()/all().
+// bits() converts a mask to an integer, one bit per lane.
+//
+// F32xN types pack floats instead, twice as many per register. Their load()
+// and store() still take doubles and convert, so the kernels don't change.
+//------------------------------------------------------------------------------
+
+// Kernels are built once per instruction set, see KernelImpl.h, none of this
+// may have external linkage.
+namespace {
+
+struct F64x1 {
+	using Mask = bool;
+	static constexpr int WIDTH = 1;
+	double v;
+
+	F64x1() = default;
+	F64x1(double v): v(v) {}
+
+	static F64x1 load(const double *p) { return *p; }
+	void store(double *p) const { *p = v; }
+	static Mask all_mask() { return true; }
+};
+
+static inline F64x1 operator+(F64x1 a, F64x1 b) { return a.v + b.v; }
+static inline F64x1 operator-(F64x1 a, F64x1 b) { return a.v - b.v; }
+static inline F64x1 operator*(F64x1 a, F64x1 b) { return a.v * b.v; }
+static inline bool cmpgt(F64x1 a, F64x1 b) { return a.v > b.v; }
+static inline bool cmple(F64x1 a, F64x1 b) { return a.v <= b.v; }
+static inline F64x1 select(bool m, F64x1 a, F64x1 b) { return m ? a : b; }
+static inline bool mask_and(bool a, bool b) { return a && b; }
+static inline bool mask_or(bool a, bool b) { return a || b; }
+static inline bool mask_andnot(bool a, bool b) { return !a && b; } // ~a & b
+static inline bool any(bool m) { return m; }
+static inline bool all(bool m) { return m; }
+static inline int bits(bool m) { return m ? 1 : 0; }
+
+struct F32x1 {
+	using Mask = bool;
+	static constexpr int WIDTH = 1;
+	float v;
+
+	F32x1() = default;
+	F32x1(double v): v((float)v) {}
+
+	static F32x1 load(const double *p) { return *p; }
+	void store(double *p) const { *p = v; }
+	static Mask all_mask() { return true; }
+};
+
+static inline F32x1 operator+(F32x1 a, F32x1 b) { return a.v + b.v; }
+static inline F32x1 operator-(F32x1 a, F32x1 b) { return a.v - b.v; }
+static inline F32x1 operator*(F32x1 a, F32x1 b) { return a.v * b.v; }
+static inline bool cmpgt(F32x1 a, F32x1 b) { return a.v > b.v; }
+static inline bool cmple(F32x1 a, F32x1 b) { return a.v <= b.v; }
+static inline F32x1 select(bool m, F32x1 a, F32x1 b) { return m ? a : b; }
+
+// Portable lane types: N independent scalars, every operation is done on
+// each of them in turn. There is no SIMD involved, but the N orbits are
+// independent dependency chains, so the FPU pipelines overlap them where a
+// single orbit stalls on the latency of every multiply. Operations are
+// unrolled at compile time, so that the lanes can live in registers, and they
+// are hidden friends, found by ADL and converting doubles like the operators
+// of the other types.
+template <int N, typename F, int ...I>
+static inline void unrolled(F &&f, std::integer_sequence<int, I...>) { (f(I), ...); }
+
+template <int N, typename F>
+static inline void each_lane(F &&f) { unrolled<N>(f, std::make_integer_sequence<int, N>()); }
+
+template <int N>
+struct LaneMask {
+	uint32_t m;
+
+	friend LaneMask mask_and(LaneMask a, LaneMask b) { return {a.m & b.m}; }
+	friend LaneMask mask_or(LaneMask a, LaneMask b) { return {a.m | b.m}; }
+	friend LaneMask mask_andnot(LaneMask a, LaneMask b) { return {~a.m & b.m}; } // ~a & b
+	friend bool any(LaneMask m) { return m.m != 0; }
+	friend bool all(LaneMask m) { return m.m == (1u << N) - 1; }
+	friend int bits(LaneMask m) { return (int)m.m; }
+};
+
+template <typename T, int N>
+struct Interleaved {
+	using Mask = LaneMask<N>;
+	static constexpr int WIDTH = N;
+	T v[N];
+
+	Interleaved() = default;
+	Interleaved(double s) { each_lane<N>([&](int i) { v[i] = (T)s; }); }
+
+	static Interleaved load(const double *p) { Interleaved r; each_lane<N>([&](int i) { r.v[i] = (T)p[i]; }); return r; }
+	void store(double *p) const { each_lane<N>([&](int i) { p[i] = v[i]; }); }
+	static Mask all_mask() { return {(1u << N) - 1}; }
+
+	friend Interleaved operator+(Interleaved a, Interleaved b) { each_lane<N>([&](int i) { a.v[i] += b.v[i]; }); return a; }
+	friend Interleaved operator-(Interleaved a, Interleaved b) { each_lane<N>([&](int i) { a.v[i] -= b.v[i]; }); return a; }
+	friend Interleaved operator*(Interleaved a, Interleaved b) { each_lane<N>([&](int i) { a.v[i] *= b.v[i]; }); return a; }
+	friend Mask cmpgt(Interleaved a, Interleaved b)
+	{
+		uint32_t m = 0;
+		each_lane<N>([&](int i) { m |= (uint32_t)(a.v[i] > b.v[i]) << i; });
+		return {m};
+	}
+	friend Mask cmple(Interleaved a, Interleaved b)
+	{
+		uint32_t m = 0;
+		each_lane<N>([&](int i) { m |= (uint32_t)(a.v[i] <= b.v[i]) << i; });
+		return {m};
+	}
+	friend Interleaved select(Mask m, Interleaved a, Interleaved b)
+	{
+		each_lane<N>([&](int i) { b.v[i] = m.m & (1u << i) ? a.v[i] : b.v[i]; });
+		return b;
+	}
+};
+
+// Two chains are enough to hide most of the latency, with more of them the
+// perturbation kernel runs out of registers. The escape time kernels use these
+// as well, double-double stays on F64x1, it gains nothing from interleaving.
+using F64x2i = Interleaved<double, 2>;
+using F32x2i = Interleaved<float, 2>;
+
+#if defined(__SSE2__)
+struct F64x2 {
+	using Mask = __m128d;
+	static constexpr int WIDTH = 2;
+	__m128d v;
+
+	F64x2() = default;
+	F64x2(__m128d v): v(v) {}
+	F64x2(double s): v(_mm_set1_pd(s)) {}
+
+	static F64x2 load(const double *p) { return _mm_loadu_pd(p); }
+	void store(double *p) const { _mm_storeu_pd(p, v); }
+	static Mask all_mask() { return _mm_castsi128_pd(_mm_set1_epi32(-1)); }
+};
+
+static inline F64x2 operator+(F64x2 a, F64x2 b) { return _mm_add_pd(a.v, b.v); }
+static inline F64x2 operator-(F64x2 a, F64x2 b) { return _mm_sub_pd(a.v, b.v); }
+static inline F64x2 operator*(F64x2 a, F64x2 b) { return _mm_mul_pd(a.v, b.v); }
+static inline __m128d cmpgt(F64x2 a, F64x2 b) { return _mm_cmpgt_pd(a.v, b.v); }
+static inline __m128d cmple(F64x2 a, F64x2 b) { return _mm_cmple_pd(a.v, b.v); }
+static inline F64x2 select(__m128d m, F64x2 a, F64x2 b) { return _mm_or_pd(_mm_and_pd(m, a.v), _mm_andnot_pd(m, b.v)); }
+static inline __m128d mask_and(__m128d a, __m128d b) { return _mm_and_pd(a, b); }
+static inline __m128d mask_or(__m128d a, __m128d b) { return _mm_or_pd(a, b); }
+static inline __m128d mask_andnot(__m128d a, __m128d b) { return _mm_andnot_pd(a, b); } // ~a & b
+static inline bool any(__m128d m) { return _mm_movemask_pd(m) != 0; }
+static inline bool all(__m128d m) { return _mm_movemask_pd(m) == 0x3; }
+static inline int bits(__m128d m) { return _mm_movemask_pd(m); }
+
+struct F32x4 {
+	using Mask = __m128;
+	static constexpr int WIDTH = 4;
+	__m128 v;
+
+	F32x4() = default;
+	F32x4(__m128 v): v(v) {}
+	F32x4(double s): v(_mm_set1_ps((float)s)) {}
+
+	static F32x4 load(const double *p) {
+		return _mm_movelh_ps(_mm_cvtpd_ps(_mm_loadu_pd(p)), _mm_cvtpd_ps(_mm_loadu_pd(p + 2)));
+	}
+	void store(double *p) const {
+		_mm_storeu_pd(p, _mm_cvtps_pd(v));
+		_mm_storeu_pd(p + 2, _mm_cvtps_pd(_mm_movehl_ps(v, v)));
+	}
+	static Mask all_mask() { return _mm_castsi128_ps(_mm_set1_epi32(-1)); }
+};
+
+static inline F32x4 operator+(F32x4 a, F32x4 b) { return _mm_add_ps(a.v, b.v); }
+static inline F32x4 operator-(F32x4 a, F32x4 b) { return _mm_sub_ps(a.v, b.v); }
+static inline F32x4 operator*(F32x4 a, F32x4 b) { return _mm_mul_ps(a.v, b.v); }
+static inline __m128 cmpgt(F32x4 a, F32x4 b) { return _mm_cmpgt_ps(a.v, b.v); }
+static inline __m128 cmple(F32x4 a, F32x4 b) { return _mm_cmple_ps(a.v, b.v); }
+static inline F32x4 select(__m128 m, F32x4 a, F32x4 b) { return _mm_or_ps(_mm_and_ps(m, a.v), _mm_andnot_ps(m, b.v)); }
+static inline __m128 mask_and(__m128 a, __m128 b) { return _mm_and_ps(a, b); }
+static inline __m128 mask_or(__m128 a, __m128 b) { return _mm_or_ps(a, b); }
+static inline __m128 mask_andnot(__m128 a, __m128 b) { return _mm_andnot_ps(a, b); } // ~a & b
+static inline bool any(__m128 m) { return _mm_movemask_ps(m) != 0; }
+static inline bool all(__m128 m) { return _mm_movemask_ps(m) == 0xF; }
+static inline int bits(__m128 m) { return _mm_movemask_ps(m); }
+#endif
+
+#if defined(__AVX2__)
+struct F64x4 {
+	using Mask = __m256d;
+	static constexpr int WIDTH = 4;
+	__m256d v;
+
+	F64x4() = default;
+	F64x4(__m256d v): v(v) {}
+	F64x4(double s): v(_mm256_set1_pd(s)) {}
+
+	static F64x4 load(const double *p) { return _mm256_loadu_pd(p); }
+	void store(double *p) const { _mm256_storeu_pd(p, v); }
+	static Mask all_mask() { return _mm256_castsi256_pd(_mm256_set1_epi32(-1)); }
+};
+
+static inline F64x4 operator+(F64x4 a, F64x4 b) { return _mm256_add_pd(a.v, b.v); }
+static inline F64x4 operator-(F64x4 a, F64x4 b) { return _mm256_sub_pd(a.v, b.v); }
+static inline F64x4 operator*(F64x4 a, F64x4 b) { return _mm256_mul_pd(a.v, b.v); }
+static inline __m256d cmpgt(F64x4 a, F64x4 b) { return _mm256_cmp_pd(a.v, b.v, _CMP_GT_OQ); }
+static inline __m256d cmple(F64x4 a, F64x4 b) { return _mm256_cmp_pd(a.v, b.v, _CMP_LE_OQ); }
+static inline F64x4 select(__m256d m, F64x4 a, F64x4 b) { return _mm256_blendv_pd(b.v, a.v, m); }
+static inline __m256d mask_and(__m256d a, __m256d b) { return _mm256_and_pd(a, b); }
+static inline __m256d mask_or(__m256d a, __m256d b) { return _mm256_or_pd(a, b); }
+static inline __m256d mask_andnot(__m256d a, __m256d b) { return _mm256_andnot_pd(a, b); } // ~a & b
+static inline bool any(__m256d m) { return _mm256_movemask_pd(m) != 0; }
+static inline bool all(__m256d m) { return _mm256_movemask_pd(m) == 0xF; }
+static inline int bits(__m256d m) { return _mm256_movemask_pd(m); }
+
+struct F32x8 {
+	using Mask = __m256;
+	static constexpr int WIDTH = 8;
+	__m256 v;
+
+	F32x8() = default;
+	F32x8(__m256 v): v(v) {}
+	F32x8(double s): v(_mm256_set1_ps((float)s)) {}
+
+	static F32x8 load(const double *p) {
+		return _mm256_set_m128(_mm256_cvtpd_ps(_mm256_loadu_pd(p + 4)), _mm256_cvtpd_ps(_mm256_loadu_pd(p)));
+	}
+	void store(double *p) const {
+		_mm256_storeu_pd(p, _mm256_cvtps_pd(_mm256_castps256_ps128(v)));
+		_mm256_storeu_pd(p + 4, _mm256_cvtps_pd(_mm256_extractf128_ps(v, 1)));
+	}
+	static Mask all_mask() { return _mm256_castsi256_ps(_mm256_set1_epi32(-1)); }
+};
+
+static inline F32x8 operator+(F32x8 a, F32x8 b) { return _mm256_add_ps(a.v, b.v); }
+static inline F32x8 operator-(F32x8 a, F32x8 b) { return _mm256_sub_ps(a.v, b.v); }
+static inline F32x8 operator*(F32x8 a, F32x8 b) { return _mm256_mul_ps(a.v, b.v); }
+static inline __m256 cmpgt(F32x8 a, F32x8 b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ); }
+static inline __m256 cmple(F32x8 a, F32x8 b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ); }
+static inline F32x8 select(__m256 m, F32x8 a, F32x8 b) { return _mm256_blendv_ps(b.v, a.v, m); }
+static inline __m256 mask_and(__m256 a, __m256 b) { return _mm256_and_ps(a, b); }
+static inline __m256 mask_or(__m256 a, __m256 b) { return _mm256_or_ps(a, b); }
+static inline __m256 mask_andnot(__m256 a, __m256 b) { return _mm256_andnot_ps(a, b); } // ~a & b
+static inline bool any(__m256 m) { return _mm256_movemask_ps(m) != 0; }
+static inline bool all(__m256 m) { return _mm256_movemask_ps(m) == 0xFF; }
+static inline int bits(__m256 m) { return _mm256_movemask_ps(m); }
+#endif
+
+#if defined(__AVX512F__)
+struct F64x8 {
+	using Mask = __mmask8;
+	static constexpr int WIDTH = 8;
+	__m512d v;
+
+	F64x8() = default;
+	F64x8(__m512d v): v(v) {}
+	F64x8(double s): v(_mm512_set1_pd(s)) {}
+
+	static F64x8 load(const double *p) { return _mm512_loadu_pd(p); }
+	void store(double *p) const { _mm512_storeu_pd(p, v); }
+	static Mask all_mask() { return 0xFF; }
+};
+
+static inline F64x8 operator+(F64x8 a, F64x8 b) { return _mm512_add_pd(a.v, b.v); }
+static inline F64x8 operator-(F64x8 a, F64x8 b) { return _mm512_sub_pd(a.v, b.v); }
+static inline F64x8 operator*(F64x8 a, F64x8 b) { return _mm512_mul_pd(a.v, b.v); }
+static inline __mmask8 cmpgt(F64x8 a, F64x8 b) { return _mm512_cmp_pd_mask(a.v, b.v, _CMP_GT_OQ); }
+static inline __mmask8 cmple(F64x8 a, F64x8 b) { return _mm512_cmp_pd_mask(a.v, b.v, _CMP_LE_OQ); }
+static inline F64x8 select(__mmask8 m, F64x8 a, F64x8 b) { return _mm512_mask_blend_pd(m, b.v, a.v); }
+static inline __mmask8 mask_and(__mmask8 a, __mmask8 b) { return a & b; }
+static inline __mmask8 mask_or(__mmask8 a, __mmask8 b) { return a | b; }
+static inline __mmask8 mask_andnot(__mmask8 a, __mmask8 b) { return ~a & b; }
+static inline bool any(__mmask8 m) { return m != 0; }
+static inline bool all(__mmask8 m) { return m == 0xFF; }
+static inline int bits(__mmask8 m) { return m; }
+
+struct F32x16 {
+	using Mask = __mmask16;
+	static constexpr int WIDTH = 16;
+	__m512 v;
+
+	F32x16() = default;
+	F32x16(__m512 v): v(v) {}
+	F32x16(double s): v(_mm512_set1_ps((float)s)) {}
+
+	static F32x16 load(const double *p) {
+		const __m256 lo = _mm512_cvtpd_ps(_mm512_loadu_pd(p));
+		const __m256 hi = _mm512_cvtpd_ps(_mm512_loadu_pd(p + 8));
+		return _mm512_castpd_ps(_mm512_insertf64x4(_mm512_castps_pd(_mm512_castps256_ps512(lo)),
+			_mm256_castps_pd(hi), 1));
+	}
+	void store(double *p) const {
+		_mm512_storeu_pd(p, _mm512_cvtps_pd(_mm512_castps512_ps256(v)));
+		_mm512_storeu_pd(p + 8, _mm512_cvtps_pd(_mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(v), 1))));
+	}
+	static Mask all_mask() { return 0xFFFF; }
+};
+
+static inline F32x16 operator+(F32x16 a, F32x16 b) { return _mm512_add_ps(a.v, b.v); }
+static inline F32x16 operator-(F32x16 a, F32x16 b) { return _mm512_sub_ps(a.v, b.v); }
+static inline F32x16 operator*(F32x16 a, F32x16 b) { return _mm512_mul_ps(a.v, b.v); }
+static inline __mmask16 cmpgt(F32x16 a, F32x16 b) { return _mm512_cmp_ps_mask(a.v, b.v, _CMP_GT_OQ); }
+static inline __mmask16 cmple(F32x16 a, F32x16 b) { return _mm512_cmp_ps_mask(a.v, b.v, _CMP_LE_OQ); }
+static inline F32x16 select(__mmask16 m, F32x16 a, F32x16 b) { return _mm512_mask_blend_ps(m, b.v, a.v); }
+static inline __mmask16 mask_and(__mmask16 a, __mmask16 b) { return a & b; }
+static inline __mmask16 mask_or(__mmask16 a, __mmask16 b) { return a | b; }
+static inline __mmask16 mask_andnot(__mmask16 a, __mmask16 b) { return ~a & b; }
+static inline bool any(__mmask16 m) { return m != 0; }
+static inline bool all(__mmask16 m) { return m == 0xFFFF; }
+static inline int bits(__mmask16 m) { return m; }
+#endif
+
+} // namespace
@@ -0,0 +1,197 @@
+#pragma once
+
+#include "Core/Utils.h"
+#include "Math/Utils.h"
+#include <stdint.h>
+#include <math.h>
+
+//------------------------------------------------------------------------------
+// BigFixed<N> is a signed fixed point number of N 32-bit limbs in two's
+// complement, least significant limb first. The top limb is the integer part,
+// the other N-1 limbs hold the fraction, so the resolution is 2^(-32(N-1)) and
+// the range is [-2^31, 2^31).
+//
+// Multiplication is truncated: partial products below the last kept limb,
+// except for one guard limb, are never computed. Their carries into the guard
+// limb are lost, so the magnitude of the result is short of the exact one by
+// less than N-1 units of the last place, and never above it.
+//------------------------------------------------------------------------------
+
+template <int N>
+struct BigFixed {
+	static_assert(N >= 2, "BigFixed needs at least one fraction limb");
+	static constexpr int FRACTION_BITS = 32 * (N - 1);
+
+	uint32_t limbs[N];
+
+	BigFixed() = default;
+	BigFixed(double v): BigFixed(v, 0) {}
+	BigFixed(double v, int64_t exp); // v * 2^exp
+	explicit operator double() const;
+
+	bool negative() const { return (int32_t)limbs[N-1] < 0; }
+};
+
+template <int N>
+static inline BigFixed<N> operator+(const BigFixed<N> &a, const BigFixed<N> &b)
+{
+	BigFixed<N> r;
+	uint64_t carry = 0;
+	for (int i = 0; i < N; i++) {
+		carry += (uint64_t)a.limbs[i] + b.limbs[i];
+		r.limbs[i] = (uint32_t)carry;
+		carry >>= 32;
+	}
+	return r;
+}
+
+template <int N>
+static inline BigFixed<N> operator-(const BigFixed<N> &a, const BigFixed<N> &b)
+{
+	BigFixed<N> r;
+	int64_t borrow = 0;
+	for (int i = 0; i < N; i++) {
+		borrow += (int64_t)a.limbs[i] - b.limbs[i];
+		r.limbs[i] = (uint32_t)borrow;
+		borrow >>= 32; // arithmetic shift, 0 or -1
+	}
+	return r;
+}
+
+template <int N>
+static inline BigFixed<N> operator-(const BigFixed<N> &a)
+{
+	BigFixed<N> r;
+	uint64_t carry = 1;
+	for (int i = 0; i < N; i++) {
+		carry += (uint32_t)~a.limbs[i];
+		r.limbs[i] = (uint32_t)carry;
+		carry >>= 32;
+	}
+	return r;
+}
+
+template <int N>
+static inline BigFixed<N> abs(const BigFixed<N> &a)
+{
+	return a.negative() ? -a : a;
+}
+
+// Column-wise product of two magnitudes, shifted right by the fraction bits.
+// Products of column k are a[i]*b[k-i], at most N of them, so a 128-bit
+// accumulator can't overflow.
+template <int N>
+static inline BigFixed<N> mul_magnitude(const BigFixed<N> &a, const BigFixed<N> &b)
+{
+	BigFixed<N> r;
+	unsigned __int128 acc = 0;
+	for (int k = N - 2; k <= 2 * N - 2; k++) {
+		const int lo = max(0, k - (N - 1));
+		const int hi = min(k, N - 1);
+		for (int i = lo; i <= hi; i++)
+			acc += (uint64_t)a.limbs[i] * b.limbs[k-i];
+		if (k >= N - 1)
+			r.limbs[k-(N-1)] = (uint32_t)acc;
+		acc >>= 32;
+	}
+	return r;
+}
+
+// Same as mul_magnitude(a, a), computes every cross product once.
+template <int N>
+static inline BigFixed<N> sqr_magnitude(const BigFixed<N> &a)
+{
+	BigFixed<N> r;
+	unsigned __int128 acc = 0;
+	for (int k = N - 2; k <= 2 * N - 2; k++) {
+		const int lo = max(0, k - (N - 1));
+		const int hi = min(k, N - 1);
+		unsigned __int128 cross = 0;
+		int i = lo, j = hi;
+		for (; i < j; i++, j--)
+			cross += (uint64_t)a.limbs[i] * a.limbs[j];
+		acc += cross << 1;
+		if (i == j)
+			acc += (uint64_t)a.limbs[i] * a.limbs[i];
+		if (k >= N - 1)
+			r.limbs[k-(N-1)] = (uint32_t)acc;
+		acc >>= 32;
+	}
+	return r;
+}
+
+template <int N>
+static inline BigFixed<N> operator*(const BigFixed<N> &a, const BigFixed<N> &b)
+{
+	const BigFixed<N> r = mul_magnitude(abs(a), abs(b));
+	return a.negative() != b.negative() ? -r : r;
+}
+
+template <int N>
+static inline BigFixed<N> sqr(const BigFixed<N> &a)
+{
+	return sqr_magnitude(abs(a));
+}
+
+// a * b + c
+template <int N>
+static inline BigFixed<N> mul_add(const BigFixed<N> &a, const BigFixed<N> &b, const BigFixed<N> &c)
+{
+	const BigFixed<N> p = mul_magnitude(abs(a), abs(b));
+	return a.negative() != b.negative() ? c - p : c + p;
+}
+
+template <int N>
+static inline BigFixed<N> &operator+=(BigFixed<N> &a, const BigFixed<N> &b) { a = a + b; return a; }
+template <int N>
+static inline BigFixed<N> &operator-=(BigFixed<N> &a, const BigFixed<N> &b) { a = a - b; return a; }
+template <int N>
+static inline BigFixed<N> &operator*=(BigFixed<N> &a, const BigFixed<N> &b) { a = a * b; return a; }
+
+template <int N>
+BigFixed<N>::BigFixed(double v, int64_t exp)
+{
+	for (int i = 0; i < N; i++)
+		limbs[i] = 0;
+	if (v == 0.0)
+		return;
+
+	int e;
+	const double f = frexp(fabs(v), &e);
+	NG_ASSERT(e + exp <= 31);
+	if (e + exp < -FRACTION_BITS)
+		return;
+	uint64_t m = (uint64_t)ldexp(f, 53);
+	// |v| = m * 2^(e+exp-53), raw value is |v| * 2^FRACTION_BITS
+	int shift = (int)(e + exp) - 53 + FRACTION_BITS;
+	if (shift < 0) {
+		if (shift <= -64)
+			return;
+		m >>= -shift;
+		shift = 0;
+	}
+	const int limb = shift / 32;
+	const int bit = shift % 32;
+	const unsigned __int128 wide = (unsigned __int128)m << bit;
+	for (int i = 0; i < 3 && limb + i < N; i++)
+		limbs[limb+i] = (uint32_t)(wide >> (32 * i));
+	if (v < 0.0)
+		*this = -*this;
+}
+
+template <int N>
+BigFixed<N>::operator double() const
+{
+	const BigFixed<N> m = abs(*this);
+	int top = N - 1;
+	while (top > 0 && m.limbs[top] == 0)
+		top--;
+
+	// top 96 bits, rounded once
+	unsigned __int128 bits = 0;
+	int low = top;
+	for (; low >= 0 && low > top - 3; low--)
+		bits = (bits << 32) | m.limbs[low];
+	const double r = ldexp((double)bits, 32 * (low + 1) - FRACTION_BITS);
+	return negative() ? -r : r;
+}
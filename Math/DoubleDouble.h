@@ -0,0 +1,124 @@
+#pragma once
+
+//------------------------------------------------------------------------------
+// Double-double arithmetic: a number is the unevaluated sum hi + lo of two
+// doubles with |lo| <= ulp(hi)/2, about 106 bits of mantissa. T is double or
+// a SIMD lane type (see Fractal/SIMD.h), only +, - and * are used.
+//
+// The error-free transformations below rely on every operation being rounded
+// on its own, code using them must be compiled with -ffp-contract=off.
+//------------------------------------------------------------------------------
+
+template <typename T>
+struct DoubleDoubleT {
+	T hi;
+	T lo;
+};
+
+using DoubleDouble = DoubleDoubleT<double>;
+
+// a + b exactly
+template <typename T>
+static inline DoubleDoubleT<T> two_sum(T a, T b)
+{
+	const T s = a + b;
+	const T bb = s - a;
+	return {s, (a - (s - bb)) + (b - bb)};
+}
+
+// a + b exactly, if |a| >= |b|
+template <typename T>
+static inline DoubleDoubleT<T> quick_two_sum(T a, T b)
+{
+	const T s = a + b;
+	return {s, b - (s - a)};
+}
+
+// a * b exactly, Dekker's product
+template <typename T>
+static inline DoubleDoubleT<T> two_prod(T a, T b)
+{
+	const T p = a * b;
+	const T ta = a * T(134217729.0); // 2^27 + 1
+	const T ah = ta - (ta - a);
+	const T al = a - ah;
+	const T tb = b * T(134217729.0);
+	const T bh = tb - (tb - b);
+	const T bl = b - bh;
+	return {p, ((ah * bh - p) + ah * bl + al * bh) + al * bl};
+}
+
+template <typename T>
+static inline DoubleDoubleT<T> operator+(const DoubleDoubleT<T> &a, const DoubleDoubleT<T> &b)
+{
+	const DoubleDoubleT<T> s = two_sum(a.hi, b.hi);
+	return quick_two_sum(s.hi, s.lo + (a.lo + b.lo));
+}
+
+template <typename T>
+static inline DoubleDoubleT<T> operator-(const DoubleDoubleT<T> &a, const DoubleDoubleT<T> &b)
+{
+	const DoubleDoubleT<T> s = two_sum(a.hi, T(0.0) - b.hi);
+	return quick_two_sum(s.hi, s.lo + (a.lo - b.lo));
+}
+
+template <typename T>
+static inline DoubleDoubleT<T> operator+(const DoubleDoubleT<T> &a, T b)
+{
+	const DoubleDoubleT<T> s = two_sum(a.hi, b);
+	return quick_two_sum(s.hi, s.lo + a.lo);
+}
+
+template <typename T>
+static inline DoubleDoubleT<T> operator*(const DoubleDoubleT<T> &a, const DoubleDoubleT<T> &b)
+{
+	const DoubleDoubleT<T> p = two_prod(a.hi, b.hi);
+	return quick_two_sum(p.hi, p.lo + (a.hi * b.lo + a.lo * b.hi));
+}
+
+template <typename T>
+static inline DoubleDoubleT<T> sqr(const DoubleDoubleT<T> &a)
+{
+	const DoubleDoubleT<T> p = two_prod(a.hi, a.hi);
+	return quick_two_sum(p.hi, p.lo + T(2.0) * a.hi * a.lo);
+}
+
+// Exact, scaling by a power of two doesn't round.
+template <typename T>
+static inline DoubleDoubleT<T> twice(const DoubleDoubleT<T> &a)
+{
+	return {a.hi + a.hi, a.lo + a.lo};
+}
+
+template <typename T>
+struct ComplexDDT {
+	DoubleDoubleT<T> re;
+	DoubleDoubleT<T> im;
+};
+
+using ComplexDD = ComplexDDT<double>;
+
+template <typename T>
+static inline ComplexDDT<T> operator+(const ComplexDDT<T> &a, const ComplexDDT<T> &b)
+{
+	return {a.re + b.re, a.im + b.im};
+}
+
+template <typename T>
+static inline ComplexDDT<T> operator*(const ComplexDDT<T> &a, const ComplexDDT<T> &b)
+{
+	return {a.re * b.re - a.im * b.im, a.re * b.im + a.im * b.re};
+}
+
+template <typename T>
+static inline ComplexDDT<T> sqr(const ComplexDDT<T> &a)
+{
+	return {sqr(a.re) - sqr(a.im), twice(a.re * a.im)};
+}
+
+// |a|^2 from the high parts only, good enough for bailout tests
+template <typename T>
+static inline T norm_hi(const ComplexDDT<T> &a)
+{
+	return a.re.hi * a.re.hi + a.im.hi * a.im.hi;
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <stdint.h>
+#include <math.h>
+
+//------------------------------------------------------------------------------
+// Floating point numbers with a double mantissa and a separate 64-bit
+// exponent, value is m * 2^e. They don't underflow where doubles do, so they
+// can hold pixel sizes and deltas of zooms past 1e-300.
+//------------------------------------------------------------------------------
+
+// 2^e as a double, 0 or inf if out of range
+static inline double exp2i(int64_t e)
+{
+	if (e < -1100)
+		return 0.0;
+	if (e > 1100)
+		return INFINITY;
+	return ldexp(1.0, (int)e);
+}
+
+// Scalar variant, always normalized: m is 0 or 0.5 <= |m| < 1.
+struct FloatExp {
+	double m = 0.0;
+	int64_t e = 0;
+
+	FloatExp() = default;
+	FloatExp(double v) { set(v, 0); }
+	FloatExp(double m, int64_t e) { set(m, e); }
+
+	explicit operator double() const { return m * exp2i(e); }
+
+private:
+	void set(double v, int64_t exp)
+	{
+		int ve;
+		m = frexp(v, &ve);
+		e = m == 0.0 ? 0 : exp + ve;
+	}
+};
+
+static inline FloatExp operator*(const FloatExp &a, const FloatExp &b) { return FloatExp(a.m * b.m, a.e + b.e); }
+static inline FloatExp operator-(const FloatExp &a) { return FloatExp(-a.m, a.e); }
+
+static inline FloatExp operator+(const FloatExp &a, const FloatExp &b)
+{
+	if (a.m == 0.0)
+		return b;
+	if (b.m == 0.0)
+		return a;
+	if (a.e >= b.e)
+		return FloatExp(a.m + b.m * exp2i(b.e - a.e), a.e);
+	return FloatExp(b.m + a.m * exp2i(a.e - b.e), b.e);
+}
+
+static inline FloatExp operator-(const FloatExp &a, const FloatExp &b) { return a + -b; }
+static inline FloatExp &operator*=(FloatExp &a, const FloatExp &b) { a = a * b; return a; }
+static inline FloatExp &operator+=(FloatExp &a, const FloatExp &b) { a = a + b; return a; }
+
+// Vectorized variant over a SIMD lane type (see Fractal/SIMD.h): all lanes
+// share the exponent. Arithmetic doesn't renormalize, mantissas are left to
+// grow or shrink within the double range and normalize() brings them back.
+// Doubles have some 2000 binary orders of magnitude to spare, so calling it
+// every few iterations is enough.
+template <typename V>
+struct FloatExpLanes {
+	V m;
+	int64_t e;
+};
+
+template <typename V>
+static inline FloatExpLanes<V> operator*(const V &a, const FloatExpLanes<V> &b) { return {a * b.m, b.e}; }
+
+template <typename V>
+static inline FloatExpLanes<V> operator*(const FloatExpLanes<V> &a, const FloatExpLanes<V> &b) { return {a.m * b.m, a.e + b.e}; }
+
+template <typename V>
+static inline FloatExpLanes<V> operator+(const FloatExpLanes<V> &a, const FloatExpLanes<V> &b)
+{
+	if (a.e >= b.e)
+		return {a.m + b.m * V(exp2i(b.e - a.e)), a.e};
+	return {b.m + a.m * V(exp2i(a.e - b.e)), b.e};
+}
+
+template <typename V>
+static inline FloatExpLanes<V> operator-(const FloatExpLanes<V> &a, const FloatExpLanes<V> &b)
+{
+	if (a.e >= b.e)
+		return {a.m - b.m * V(exp2i(b.e - a.e)), a.e};
+	return {a.m * V(exp2i(a.e - b.e)) - b.m, b.e};
+}
+
+// Lanes as plain doubles, flushed to zero where they underflow.
+template <typename V>
+static inline V to_lanes(const FloatExpLanes<V> &a)
+{
+	return a.m * V(exp2i(a.e));
+}
+
+// Rescales mantissas so that the largest one is in [0.5, 1). All zero lanes
+// keep their exponent.
+template <typename V>
+static inline void normalize(FloatExpLanes<V> *a)
+{
+	double m[V::WIDTH];
+	a->m.store(m);
+	double largest = 0.0;
+	for (int i = 0; i < V::WIDTH; i++)
+		largest = fmax(largest, fabs(m[i]));
+	if (largest == 0.0)
+		return;
+	int shift;
+	frexp(largest, &shift);
+	a->m = a->m * V(ldexp(1.0, -shift));
+	a->e += shift;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdio.h>
+
+// Minimal checks for the test executables: failures are printed and counted,
+// main() returns check_failures() so that ctest sees them.
+static int checkFailures = 0;
+
+#define CHECK(cond)                                                            \
+	do {                                                                       \
+		if (!(cond)) {                                                         \
+			printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);    \
+			checkFailures++;                                                   \
+		}                                                                      \
+	} while (0)
+
+static inline int check_failures() {
+	if (checkFailures != 0)
+		printf("%d checks failed\n", checkFailures);
+	return checkFailures != 0 ? 1 : 0;
+}
@@ -0,0 +1,94 @@
+#include "Fractal/Kernel.h"
+#include "Math/Utils.h"
+#include "Tests/Check.h"
+#include <math.h>
+
+static const int MAX_ITER = 1024;
+
+static void iterate(Formula formula, Slice<const double> x, Slice<const double> y, Slice<int> iters,
+	Slice<float> dist = {})
+{
+	KernelParams params;
+	params.max_iter = MAX_ITER;
+	params.formula = formula;
+	escape_time(iters, Slice<float>(), x, y, params, nullptr, nullptr, dist);
+}
+
+// Squares the subdivision fills from sample (x, y) going by its estimate: the
+// sample is a corner, the diagonal as long as the estimate, one per quadrant.
+// Nothing in them may be in the set, and as filled values are interpolated
+// between the corners, nothing may escape later than the latest corner. One
+// iteration of slack is left for the integer bands, which needn't line up
+// with the estimate.
+static void check_fills(Formula formula, double x, double y, float dist) {
+	const int side = 9;
+	const double s = dist / sqrt(2.0);
+	for (int q = 0; q < 4; q++) {
+		const double sx = q & 1 ? s : -s;
+		const double sy = q & 2 ? s : -s;
+		double px[side*side], py[side*side];
+		int iters[side*side];
+		for (int j = 0; j < side; j++) {
+			for (int i = 0; i < side; i++) {
+				px[j*side+i] = x + sx * i / (side - 1);
+				py[j*side+i] = y + sy * j / (side - 1);
+			}
+		}
+		iterate(formula, px, py, iters);
+		const int corners[] = {0, side-1, side*(side-1), side*side-1};
+		int latest = 0;
+		for (int c : corners)
+			latest = max(latest, iters[c]);
+		for (int i = 0; i < side*side; i++)
+			CHECK(iters[i] < MAX_ITER && iters[i] <= latest + 1);
+	}
+}
+
+int main() {
+	init_kernels();
+
+	// On the real axis the distance to the Mandelbrot set is known: it spans
+	// [-2, 1/4] there.
+	const int n = 2000;
+	double x[n], y[n];
+	int iters[n];
+	float dist[n];
+	for (int i = 0; i < n; i++) {
+		x[i] = i % 2 ? -2.0 - 1e-3 * (i+1) : 0.25 + 1e-3 * (i+1);
+		y[i] = 0.0;
+	}
+	iterate(Formula::MANDELBROT, x, y, iters, dist);
+	for (int i = 0; i < n; i++)
+		CHECK(dist[i] > 0.0f && dist[i] <= (x[i] < 0.0 ? -2.0 - x[i] : x[i] - 0.25));
+
+	// fills across the plane, for each formula with estimates
+	const int grid = 48;
+	double gx[grid*grid], gy[grid*grid];
+	int giters[grid*grid];
+	float gdist[grid*grid];
+	for (int j = 0; j < grid; j++) {
+		for (int i = 0; i < grid; i++) {
+			gx[j*grid+i] = -2.5 + 4.0 * (i + 0.5) / grid;
+			gy[j*grid+i] = -2.0 + 4.0 * (j + 0.5) / grid;
+		}
+	}
+	for (Formula f : {Formula::MANDELBROT, Formula::MULTIBROT3, Formula::MULTIBROT4}) {
+		iterate(f, gx, gy, giters, gdist);
+		int estimated = 0;
+		for (int i = 0; i < grid*grid; i++) {
+			if (gdist[i] <= 0.0f)
+				continue;
+			estimated++;
+			check_fills(f, gx[i], gy[i], gdist[i]);
+		}
+		CHECK(estimated > grid*grid / 2);
+	}
+
+	// no estimates where they don't hold
+	for (Formula f : {Formula::JULIA, Formula::BURNING_SHIP}) {
+		iterate(f, gx, gy, giters, gdist);
+		for (int i = 0; i < grid*grid; i++)
+			CHECK(gdist[i] == 0.0f);
+	}
+	return check_failures();
+}
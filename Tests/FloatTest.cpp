@@ -0,0 +1,76 @@
+#include "Core/Vector.h"
+#include "Fractal/Kernel.h"
+#include "Tests/Check.h"
+#include <math.h>
+
+static const int MAX_ITER = 1024;
+
+// Samples of the default view around the seahorse valley, at its pixel size:
+// the boundary, bulbs and points escaping at every count up to MAX_ITER.
+static const int GRID = 400;
+static const double PIXEL = 0.00235;
+
+static KernelParams params(int max_iter) {
+	KernelParams p;
+	p.max_iter = max_iter;
+	p.periodicity_eps = PIXEL * 1e-3;
+	return p;
+}
+
+int main() {
+	init_kernels();
+
+	const int n = GRID * GRID;
+	Vector<double> x(n), y(n);
+	for (int j = 0; j < GRID; j++) {
+		for (int i = 0; i < GRID; i++) {
+			x[j*GRID+i] = -0.75 + (i - GRID/2 + 0.5) * PIXEL;
+			y[j*GRID+i] = (j - GRID/2 + 0.5) * PIXEL;
+		}
+	}
+
+	// floats agree with doubles on the set and to within an iteration on the
+	// escape times
+	Vector<int> di(n), fi(n);
+	Vector<float> ds(n), fs(n);
+	escape_time(di.sub(), ds.sub(), x.sub(), y.sub(), params(MAX_ITER));
+	escape_time_float(fi.sub(), fs.sub(), x.sub(), y.sub(), params(MAX_ITER));
+	int interior = 0, late = 0;
+	for (int i = 0; i < n; i++) {
+		CHECK((di[i] == MAX_ITER) == (fi[i] == MAX_ITER));
+		CHECK(abs(di[i] - fi[i]) <= 1);
+		if (di[i] < MAX_ITER && fi[i] < MAX_ITER)
+			CHECK(fabsf(ds[i] - fs[i]) <= 1.0f);
+		interior += di[i] == MAX_ITER;
+		late += di[i] >= 64 && di[i] < MAX_ITER;
+	}
+	CHECK(interior > n / 10 && late > n / 100);
+
+	// orbits saved at a low limit continue to the same escape times
+	Vector<int> iter(n, 0);
+	Vector<double> zr(n), zi(n);
+	const OrbitState state = {iter.sub(), zr.sub(), zi.sub(), {}, {}};
+	escape_time_float(fi.sub(), fs.sub(), x.sub(), y.sub(), params(100), nullptr, &state);
+	Vector<int> rest;
+	for (int i = 0; i < n; i++) {
+		CHECK(iter[i] == ORBIT_DONE || iter[i] == 100);
+		CHECK(iter[i] != ORBIT_DONE || (fi[i] == 100 ? di[i] == MAX_ITER : abs(fi[i] - di[i]) <= 1));
+		if (iter[i] != ORBIT_DONE)
+			rest.append(i);
+	}
+	CHECK(rest.length() != 0);
+	const int m = rest.length();
+	Vector<double> rx(m), ry(m), rzr(m), rzi(m);
+	Vector<int> riter(m, 100), out(m);
+	for (int i = 0; i < m; i++) {
+		rx[i] = x[rest[i]];
+		ry[i] = y[rest[i]];
+		rzr[i] = zr[rest[i]];
+		rzi[i] = zi[rest[i]];
+	}
+	const OrbitState resumed = {riter.sub(), rzr.sub(), rzi.sub(), {}, {}};
+	escape_time_float(out.sub(), Slice<float>(), rx.sub(), ry.sub(), params(MAX_ITER), nullptr, &resumed);
+	for (int i = 0; i < m; i++)
+		CHECK(out[i] == di[rest[i]]);
+	return check_failures();
+}
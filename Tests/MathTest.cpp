@@ -0,0 +1,267 @@
+#include "Fractal/SIMD.h"
+#include "Math/BigFixed.h"
+#include "Math/DoubleDouble.h"
+#include "Math/FloatExp.h"
+#include "Tests/Check.h"
+
+// Has to be compiled with -ffp-contract=off, same as the kernels, see
+// DoubleDouble.h.
+
+static uint64_t rngState = 0x9E3779B97F4A7C15ull;
+
+// xorshift64*, reproducible across platforms
+static uint64_t next_random() {
+	rngState ^= rngState >> 12;
+	rngState ^= rngState << 25;
+	rngState ^= rngState >> 27;
+	return rngState * 0x2545F4914F6CDD1Dull;
+}
+
+// uniform in [-range, range)
+static double random_double(double range) {
+	return ((double)(next_random() >> 11) * 0x1p-53 * 2.0 - 1.0) * range;
+}
+
+template <int N>
+static BigFixed<N> random_fixed(int int_bits) {
+	BigFixed<N> r;
+	for (int i = 0; i < N; i++)
+		r.limbs[i] = (uint32_t)next_random();
+	// sign extend the top limb from `int_bits` bits
+	r.limbs[N-1] = (uint32_t)((int32_t)(r.limbs[N-1] << (32 - int_bits)) >> (32 - int_bits));
+	return r;
+}
+
+template <int N>
+static bool equal(const BigFixed<N> &a, const BigFixed<N> &b) {
+	for (int i = 0; i < N; i++) {
+		if (a.limbs[i] != b.limbs[i])
+			return false;
+	}
+	return true;
+}
+
+template <int N>
+static bool is_zero(const BigFixed<N> &a) {
+	return equal(a, BigFixed<N>(0.0));
+}
+
+// How far truncated product `p` is short of `exact` in magnitude, in units of
+// the last place, 2^31 if it's above or too far.
+template <int N>
+static uint32_t ulps_short(const BigFixed<N> &p, const BigFixed<N> &exact) {
+	const BigFixed<N> d = abs(exact) - abs(p);
+	if (d.negative())
+		return 1u << 31;
+	for (int i = 1; i < N; i++) {
+		if (d.limbs[i] != 0)
+			return 1u << 31;
+	}
+	return min(d.limbs[0], 1u << 31);
+}
+
+// a * b with every partial product, truncated towards zero like operator*
+template <int N>
+static BigFixed<N> exact_mul(const BigFixed<N> &a, const BigFixed<N> &b) {
+	const BigFixed<N> x = abs(a);
+	const BigFixed<N> y = abs(b);
+	uint32_t wide[2*N] = {};
+	for (int i = 0; i < N; i++) {
+		uint64_t carry = 0;
+		for (int j = 0; j < N; j++) {
+			carry += (uint64_t)x.limbs[i] * y.limbs[j] + wide[i+j];
+			wide[i+j] = (uint32_t)carry;
+			carry >>= 32;
+		}
+		wide[i+N] = (uint32_t)carry;
+	}
+	BigFixed<N> r;
+	for (int i = 0; i < N; i++)
+		r.limbs[i] = wide[i+N-1];
+	return a.negative() != b.negative() ? -r : r;
+}
+
+template <int N>
+static void check_big_fixed() {
+	using F = BigFixed<N>;
+	const int bits = F::FRACTION_BITS;
+
+	// doubles with all their bits above the resolution convert exactly
+	for (int i = 0; i < 1000; i++) {
+		const int64_t m = (int64_t)(next_random() >> 24) - ((int64_t)1 << 39);
+		const double v = ldexp((double)m, -min(bits, 40));
+		CHECK((double)F(v) == v);
+		CHECK((double)-F(v) == -v);
+		CHECK(F(v).negative() == (v < 0.0));
+	}
+	CHECK((double)F(-2.5) == -2.5);
+	CHECK(is_zero(F(-2.5) + F(2.5)));
+	CHECK((double)F(3.0, -2) == 0.75);
+	CHECK((double)F(-1.0, 30) == -1073741824.0);
+
+	// the last place and below it
+	const F ulp = F(1.0, -bits);
+	CHECK(ulp.limbs[0] == 1);
+	CHECK((double)ulp == ldexp(1.0, -bits));
+	CHECK(equal(F(1.5, -bits), ulp));
+	const F minus_ulp = F(-1.0, -bits);
+	for (int i = 0; i < N; i++)
+		CHECK(minus_ulp.limbs[i] == 0xFFFFFFFFu);
+	CHECK(is_zero(F(1.0, -bits - 1)));
+	CHECK(is_zero(F(1.0, -bits - 2)));
+	CHECK(is_zero(F(-1.0, -bits - 2)));
+	CHECK(is_zero(F(-0.75, -bits - 40)));
+	CHECK(is_zero(F(1.0, -100000)));
+
+	// truncated products are short by less than N-1 units of the last place,
+	// see BigFixed.h, sqr and mul_add do the same work as operator*
+	uint32_t worst = 0;
+	for (int i = 0; i < 2000; i++) {
+		const F a = random_fixed<N>(15);
+		const F b = random_fixed<N>(15);
+		const F c = random_fixed<N>(15);
+		const F p = a * b;
+		worst = max(worst, ulps_short(p, exact_mul(a, b)));
+		CHECK(equal(a * b, b * a));
+		CHECK(equal(sqr(a), a * a));
+		CHECK(equal(sqr(-a), a * a));
+		CHECK(equal(mul_add(a, b, c), c + p));
+		CHECK(equal(mul_add(-a, b, c), c - p));
+		worst = max(worst, ulps_short(sqr(a), exact_mul(a, a)));
+	}
+	CHECK(worst <= (uint32_t)N - 1);
+
+	// products of doubles, against the double result where it's exact
+	for (int i = 0; i < 1000; i++) {
+		const double x = (double)(int16_t)(next_random() >> 48) * 0x1p-8;
+		const double y = (double)(int16_t)(next_random() >> 48) * 0x1p-8;
+		CHECK((double)(F(x) * F(y)) == x * y);
+		CHECK((double)mul_add(F(x), F(y), F(1.0)) == x * y + 1.0);
+	}
+}
+
+// two lanes of the portable lane type, any CPU runs it
+static F64x2i lanes2(double a, double b) {
+	const double v[2] = {a, b};
+	return F64x2i::load(v);
+}
+
+static void check_float_exp() {
+	// normalized: m is 0 or 0.5 <= |m| < 1
+	for (int i = 0; i < 1000; i++) {
+		const double v = random_double(1.0) * ldexp(1.0, (int)(next_random() % 2000) - 1000);
+		const FloatExp f(v);
+		CHECK(f.m == 0.0 || (fabs(f.m) >= 0.5 && fabs(f.m) < 1.0));
+		CHECK((double)f == v);
+	}
+	CHECK(FloatExp(0.0).m == 0.0 && FloatExp(0.0).e == 0);
+	CHECK(FloatExp(0.0, -5000).e == 0);
+	const FloatExp deep(3.0, -2000);
+	CHECK(deep.m == 0.75 && deep.e == -1998);
+	CHECK((double)deep == 0.0);
+	CHECK((double)FloatExp(1.0, 2000) == INFINITY);
+
+	// products don't underflow where doubles would
+	const FloatExp p = FloatExp(1.0, -700) * FloatExp(-1.0, -700);
+	CHECK(p.m == -0.5 && p.e == -1399);
+
+	// sums across exponent gaps
+	const FloatExp a(1.0, -5000);
+	const FloatExp s30 = a + FloatExp(1.0, -5030);
+	CHECK(s30.m == 0.5 + 0x1p-31 && s30.e == -4999);
+	const FloatExp s52 = FloatExp(1.0, -5052) + a;
+	CHECK(s52.m == 0.5 + 0x1p-53 && s52.e == -4999);
+	const FloatExp s60 = a + FloatExp(1.0, -5060);
+	CHECK(s60.m == 0.5 && s60.e == -4999);
+	const FloatExp far = FloatExp(1.0, -9000) + a;
+	CHECK(far.m == 0.5 && far.e == -4999);
+	const FloatExp r = a - FloatExp(0.75, -5000);
+	CHECK(r.m == 0.5 && r.e == -5001);
+	CHECK((a - a).m == 0.0);
+	CHECK((FloatExp() + a).m == a.m && (FloatExp() + a).e == a.e);
+
+	// lanes share the exponent, normalize() scales by the largest lane
+	FloatExpLanes<F64x2i> lanes = {lanes2(3.0, -0.001), -1000};
+	normalize(&lanes);
+	double m[2];
+	lanes.m.store(m);
+	CHECK(m[0] == 0.75 && m[1] == -0.001 / 4.0 && lanes.e == -998);
+	const FloatExpLanes<F64x2i> sum = lanes + FloatExpLanes<F64x2i>{lanes2(1.0, 1.0), -1040};
+	sum.m.store(m);
+	CHECK(m[0] == 0.75 + 0x1p-42 && sum.e == -998);
+	FloatExpLanes<F64x2i> zero = {lanes2(0.0, 0.0), -7};
+	normalize(&zero);
+	CHECK(zero.e == -7);
+	to_lanes(FloatExpLanes<F64x2i>{lanes2(1.0, 0.5), -1080}).store(m);
+	CHECK(m[0] == 0.0 && m[1] == 0.0);
+}
+
+// Exact references for the double-double checks. The doubles below are all
+// multiples of 2^-112 and under 2^31, and none of the products needs more
+// than its 224 bits of fraction, so nothing is cut off.
+using Exact = BigFixed<8>;
+
+static Exact to_exact(const DoubleDouble &a) {
+	return Exact(a.hi) + Exact(a.lo);
+}
+
+// |hi| < range, a power of two no larger than 4, scaled down by up to 2^-3 so
+// that sums round, and lo 5 to 8 bits below the last bit of hi: more bits
+// than a double-double holds
+static DoubleDouble random_dd(double range) {
+	const double hi = random_double(range) * ldexp(1.0, -(int)(next_random() % 4));
+	return quick_two_sum(hi, random_double(range * 0x1p-60));
+}
+
+// |x - y| <= |y| * 2^-bits
+static bool close(const Exact &x, const Exact &y, int bits) {
+	const Exact bound = exact_mul(abs(y), Exact(1.0, -bits));
+	return !(bound - abs(x - y)).negative();
+}
+
+static void check_double_double() {
+	// error-free transformations
+	for (int i = 0; i < 1000; i++) {
+		const double a = random_double(0x1p13);
+		const double b = random_double(1.0) * ldexp(1.0, (int)(next_random() % 60) - 50);
+		const DoubleDouble s = two_sum(a, b);
+		CHECK(equal(to_exact(s), Exact(a) + Exact(b)));
+		CHECK(s.hi == a + b);
+		const DoubleDouble p = two_prod(a, b);
+		CHECK(equal(to_exact(p), exact_mul(Exact(a), Exact(b))));
+		CHECK(p.hi == a * b);
+	}
+
+	// about 106 bits: within 2^-104 relative for sums without cancellation
+	// and 2^-103 for products
+	for (int i = 0; i < 10000; i++) {
+		const DoubleDouble a = random_dd(4.0);
+		DoubleDouble b = random_dd(4.0);
+		if ((a.hi < 0.0) != (b.hi < 0.0))
+			b = {-b.hi, -b.lo};
+		const DoubleDouble s = a + b;
+		CHECK(close(to_exact(s), to_exact(a) + to_exact(b), 104));
+		const DoubleDouble p = a * b;
+		CHECK(close(to_exact(p), exact_mul(to_exact(a), to_exact(b)), 103));
+		const DoubleDouble q = sqr(a);
+		CHECK(close(to_exact(q), exact_mul(to_exact(a), to_exact(a)), 103));
+		// normalized: lo within half an ulp of hi
+		CHECK(fabs(s.lo) <= 0.5 * fabs(s.hi) * 0x1p-52);
+		CHECK(fabs(p.lo) <= 0.5 * fabs(p.hi) * 0x1p-52);
+	}
+
+	// differences are exact where they cancel completely
+	const DoubleDouble x = random_dd(1.0);
+	const DoubleDouble d = x - x;
+	CHECK(d.hi == 0.0 && d.lo == 0.0);
+	CHECK(equal(to_exact(twice(x)), to_exact(x) + to_exact(x)));
+}
+
+int main() {
+	check_big_fixed<2>();
+	check_big_fixed<4>();
+	check_big_fixed<48>();
+	check_float_exp();
+	check_double_double();
+	return check_failures();
+}
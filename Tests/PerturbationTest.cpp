@@ -0,0 +1,38 @@
+#include "Fractal/Perturbation.h"
+#include "Tests/Check.h"
+
+int main() {
+	init_kernels();
+
+	// c = i at a 1e-200 wide view: pixels are about 2^-674, the view spans
+	// 1024 of them. The reference is computed past the limit, as raised
+	// references are, and the series stays valid past it as well.
+	const int max_iter = 256;
+	const double radius = 1024.0;
+	const double tolerance = 1e-8;
+	Reference ref;
+	ref.compute(HPVec2(HPReal(0.0), HPReal(1.0)), 4 * max_iter, -674);
+	CHECK(ref.series_skip(4 * max_iter, radius, tolerance) > max_iter);
+
+	// the skip stops short of the limit instead of being dropped
+	const int skip = ref.series_skip(max_iter, radius, tolerance);
+	CHECK(skip > 0 && skip < max_iter);
+	const ReferenceOrbit orbit = ref.orbit(max_iter, radius, tolerance);
+	CHECK(orbit.series.iters == skip);
+
+	double dcr[16], dci[16];
+	int iters[16];
+	for (int i = 0; i < 16; i++) {
+		dcr[i] = radius * (i % 4 - 1.5) / 2.0;
+		dci[i] = radius * (i / 4 - 1.5) / 2.0;
+	}
+	KernelParams params;
+	params.max_iter = max_iter;
+	KernelStats stats;
+	perturbation(iters, Slice<float>(), dcr, dci,
+		orbit, params, &stats);
+	CHECK(stats.series_skipped > 0);
+	for (int i = 0; i < 16; i++)
+		CHECK(iters[i] == max_iter);
+	return check_failures();
+}
@@ -0,0 +1,21 @@
+#include "Fractal/Precision.h"
+#include "Tests/Check.h"
+
+int main() {
+	// default view
+	CHECK(choose_precision(FloatExp(0.00235), 0.5) == Precision::FLOAT);
+	CHECK(choose_precision(FloatExp(1e-5), 0.75) == Precision::DOUBLE);
+	CHECK(choose_precision(FloatExp(1e-14), 0.75) == Precision::DOUBLE_DOUBLE);
+
+	// deep zooms centred at the origin and on the imaginary axis close to it,
+	// orbits still pass |z| ~ 1 there
+	CHECK(choose_precision(FloatExp(1e-14), 0.0) == Precision::DOUBLE_DOUBLE);
+	CHECK(choose_precision(FloatExp(1e-30), 0.0) == Precision::PERTURBATION);
+	CHECK(choose_precision(FloatExp(1e-14), 1e-9) == Precision::DOUBLE_DOUBLE);
+	CHECK(choose_precision(FloatExp(1e-30), 1e-9) == Precision::PERTURBATION);
+	CHECK(choose_precision(FloatExp(1.0, -1000), 0.0) == Precision::PERTURBATION_FLOATEXP);
+
+	// magnitudes past the floor still count
+	CHECK(choose_precision(FloatExp(1e-12), 1.9) == Precision::DOUBLE_DOUBLE);
+	return check_failures();
+}
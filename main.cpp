@@ -1,25 +1,49 @@
 #include "Core/BitArray.h"
 #include "Core/UniquePtr.h"
 #include "Core/Vector.h"
+#include "Fractal/Kernel.h"
+#include "Fractal/Perturbation.h"
+#include "Fractal/Precision.h"
 #include "Math/Color.h"
+#include "Math/DoubleDouble.h"
+#include "Math/FloatExp.h"
 #include "Math/Rect.h"
 #include "Math/Utils.h"
 #include "Math/Vec.h"
 #include "OS/AsyncQueue.h"
 
-#include <complex>
+#include <atomic>
 #include <experimental/coroutine>
 #include <initializer_list>
 #include <SDL2/SDL_opengl.h>
 #include <SDL2/SDL.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 namespace stdx = std::experimental;
 
 using CoroutineHandle = stdx::coroutine_handle<>;
 using CoroutineQueue = AsyncQueue<CoroutineHandle>;
 
-UniquePtr<CoroutineQueue> globalQueue;
+// States of a droppable job, see push_droppable().
+enum JobState {
+	JOB_QUEUED,
+	JOB_TAKEN, // by a worker, the coroutine runs
+	JOB_DROPPED, // by drop_job(), the coroutine won't run
+	JOB_DISCARDED, // dropped and the worker is done with it, state can go
+};
+
+// Coroutine for a worker to resume. `state`, if not null, makes the job
+// droppable while it waits in the queue: whoever moves it off JOB_QUEUED
+// first, the worker popping the job or drop_job(), decides whether the
+// coroutine runs. A dropped one is destroyed without running.
+struct Job {
+	CoroutineHandle coro;
+	std::atomic<int> *state = nullptr;
+};
+using JobQueue = AsyncQueue<Job>;
+
+UniquePtr<JobQueue> globalQueue;
 UniquePtr<CoroutineQueue> mainThreadQueue;
 
 struct Awaiter {
@@ -28,7 +52,7 @@ struct Awaiter {
 
 	void push_or_destroy() {
 		if (globalQueue)
-			globalQueue->push(coro);
+			globalQueue->push(Job{coro});
 		else
 			coro.destroy();
 	}
@@ -84,7 +108,7 @@ struct Task {
 	// When somebody asks for our value we do a suspend and that's when Task is actually scheduled for execution.
 	void await_suspend(CoroutineHandle c) {
 		coro.promise().awaiter = Awaiter(c);
-		globalQueue->push(coro);
+		globalQueue->push(Job{coro});
 	}
 };
 
@@ -127,7 +151,7 @@ struct MultiTaskAwaiter {
 	void await_suspend(CoroutineHandle c) {
 		for (auto &t : tasks) {
 			t.coro.promise().awaiter = Awaiter(c, &count);
-			globalQueue->push(t.coro);
+			globalQueue->push(Job{t.coro});
 		}
 	}
 
@@ -183,30 +207,66 @@ auto co_main(Task<T> task) {
 	return MainThreadAwaiter(std::move(task));
 }
 
+// Queues task `t` for a worker. It can be dropped with `state` until a
+// worker takes it, see drop_job().
+//
+// `state` belongs to the caller, not to the coroutine frame: a dropped frame
+// is destroyed by the worker that pops it, at any time after drop_job(), and
+// a finished one destroys itself. The caller keeps `state` alive until the
+// job is JOB_TAKEN or JOB_DISCARDED, or the workers are gone.
+void push_droppable(Task<void> t, std::atomic<int> *state) {
+	state->store(JOB_QUEUED, std::memory_order_relaxed);
+	globalQueue->push(Job{t.coro, state});
+}
+
+// Drops the job of push_droppable() `state`, returns false if a worker took
+// it already.
+bool drop_job(std::atomic<int> *state) {
+	int queued = JOB_QUEUED;
+	return state->compare_exchange_strong(queued, JOB_DROPPED);
+}
+
+// Returns true once the worker popped dropped job `state` and destroyed its
+// coroutine.
+bool job_discarded(const std::atomic<int> *state) {
+	return state->load(std::memory_order_acquire) == JOB_DISCARDED;
+}
+
 int worker_thread(void*) {
 	while (true) {
-		auto next = globalQueue->pop();
-		if (next == nullptr) {
+		const Job next = globalQueue->pop();
+		if (next.coro == nullptr) {
 			return 0;
 		}
 
-		if (!next.done()) {
-			next.resume();
+		int queued = JOB_QUEUED;
+		if (next.state && !next.state->compare_exchange_strong(queued, JOB_TAKEN)) {
+			next.coro.destroy();
+			next.state->store(JOB_DISCARDED, std::memory_order_release);
+			continue;
+		}
+		if (!next.coro.done()) {
+			next.coro.resume();
 		}
 	}
 }
 
 Vector<SDL_Thread*> workers;
 int numCPUs = 0;
+bool printStats = false; // CPPMANDEL_STATS env var, per tile work counters
+double seriesTolerance = 1e-8; // CPPMANDEL_SA_TOLERANCE env var, 0 disables series approximation
+int aaSamples = 4; // CPPMANDEL_AA env var, anti-aliasing samples per pixel: 1, 4 or 16
+int paletteShift = 0; // C key, palette rotation in palette entries, main thread only
+bool smoothColoring = true; // S key, blend palette entries by the fractional escape time, same
 
 void terminate_workers() {
 	for (int i = 0; i < workers.length(); i++) {
-		globalQueue->push(nullptr);
+		globalQueue->push(Job{});
 	}
 }
 
 void init_workers() {
-	globalQueue = make_unique<CoroutineQueue>();
+	globalQueue = make_unique<JobQueue>();
 	mainThreadQueue = make_unique<CoroutineQueue>();
 	numCPUs = SDL_GetCPUCount();//min(8, SDL_GetCPUCount());
 	for (int i = 0; i < numCPUs; i++) {
@@ -285,7 +345,24 @@ struct ColorRange {
 	float range;
 };
 
-static inline constexpr int ITERATIONS = 1024;
+// Iteration limits. Views start at a limit picked from their zoom depth and
+// from how far the escape times of the previous view went, tiles then raise
+// it RAISE_FACTOR times over, up to MAX_RAISE times the start and
+// MAX_RAISED_ITERATIONS at most, as long as their pixels keep escaping close
+// to it.
+static inline constexpr int MIN_ITERATIONS = 256;
+static inline constexpr int MAX_ITERATIONS = 16384; // to start a view with
+static inline constexpr int DEPTH_ITERATIONS = 32; // more per halving of the pixel size
+static inline constexpr int RAISE_FACTOR = 4;
+static inline constexpr int MAX_RAISE = 16;
+// Raised limits never go past this. Views starting close to MAX_ITERATIONS
+// would otherwise raise to a quarter million iterations, with orbits and
+// references to match, for the few pixels next to the set.
+static inline constexpr int MAX_RAISED_ITERATIONS = 65536;
+static inline constexpr double DEFAULT_PIXEL = 0.00235; // size of a pixel at the default zoom
+// The palette repeats every PALETTE_SPAN times the starting limit of a view.
+static inline constexpr int PALETTE_SPAN = 4;
+static inline constexpr int PALETTE_SIZE = 1024;
 static inline constexpr RGBA8 DARK_YELLOW(0xEE, 0xEE, 0x9E, 0xFF);
 static inline constexpr RGBA8 DARK_GREEN(0x44, 0x88, 0x44, 0xFF);
 static inline constexpr RGBA8 PALE_GREY_BLUE(0x49, 0x93, 0xDD, 0xFF);
@@ -301,20 +378,21 @@ static inline constexpr ColorRange COLOR_SCALE[] = {
 	{WHITE, PALE_GREY_BLUE, 0.125f},
 };
 
+// COLOR_SCALE sampled at PALETTE_SIZE points, indexed by escape time
+// normalised to the palette period rather than by iteration.
 struct Palette {
-	RGBA8 palette[ITERATIONS+1];
+	RGBA8 palette[PALETTE_SIZE];
 	constexpr Palette(): palette{} {
 		int p = 0;
 		for (int i = 0; i < int(sizeof(COLOR_SCALE)/sizeof(*COLOR_SCALE)); i++) {
 			auto r = COLOR_SCALE[i];
-			int n = r.range * ITERATIONS + 0.5;
-			for (int j = 0; j < n && j < ITERATIONS; j++) {
+			int n = r.range * PALETTE_SIZE + 0.5;
+			for (int j = 0; j < n && p < PALETTE_SIZE; j++) {
 				auto c = lerp(r.from, r.to, (float)j/n);
 				palette[p] = c;
 				p++;
 			}
 		}
-		palette[ITERATIONS] = BLACK;
 	}
 
 	constexpr RGBA8 operator[](int i) const { return palette[i]; }
@@ -322,78 +400,1043 @@ struct Palette {
 
 static inline constexpr Palette palette;
 
-RGBA8 mandelbrot_at(std::complex<double> c) {
-	auto z = std::complex<double>(0, 0);
-	for (int i = 0; i < ITERATIONS; i++) {
-		z = z * z + c;
-		if (z.real() * z.real() + z.imag() * z.imag() > 4.0) {
-			return palette[i];
+// Palette color of a smooth escape time, `max_iter` and above is the interior.
+// The palette repeats every `period` iterations.
+static inline RGBA8 smooth_color(float mu, int max_iter, int period) {
+	if (mu >= (float)max_iter)
+		return BLACK;
+	mu = max(mu, 0.0f);
+	if (!smoothColoring)
+		mu = floorf(mu);
+	const float t = mu * ((float)PALETTE_SIZE / (float)period);
+	const int i = (int)t;
+	const RGBA8 c = palette[(i + paletteShift) % PALETTE_SIZE];
+	if (!smoothColoring)
+		return c;
+	return lerp(c, palette[(i + 1 + paletteShift) % PALETTE_SIZE], t - (float)i);
+}
+
+// Escaped samples by iteration count, ESCAPE_OCTAVE_BUCKETS buckets per
+// power of two.
+static inline constexpr int ESCAPE_OCTAVE_BUCKETS = 4;
+static inline constexpr int ESCAPE_BUCKETS = 24 * ESCAPE_OCTAVE_BUCKETS;
+
+struct EscapeHistogram {
+	int64_t buckets[ESCAPE_BUCKETS] = {};
+	int64_t total = 0;
+
+	void add(int iter) {
+		const int b = (int)(ESCAPE_OCTAVE_BUCKETS * log2((double)iter + 1.0));
+		buckets[min(b, ESCAPE_BUCKETS-1)]++;
+		total++;
+	}
+
+	// Iteration count at least `fraction` of the samples escaped by, rounded
+	// up to a bucket boundary. 0 if there are none.
+	int percentile(double fraction) const {
+		int64_t sum = 0;
+		for (int b = 0; b < ESCAPE_BUCKETS; b++) {
+			sum += buckets[b];
+			if (total != 0 && (double)sum >= fraction * (double)total)
+				return (int)ceil(exp2((double)(b + 1) / ESCAPE_OCTAVE_BUCKETS)) - 1;
 		}
+		return 0;
+	}
+
+	EscapeHistogram &operator+=(const EscapeHistogram &h) {
+		for (int b = 0; b < ESCAPE_BUCKETS; b++)
+			buckets[b] += h.buckets[b];
+		total += h.total;
+		return *this;
 	}
-	return palette[ITERATIONS];
+};
+
+// `n` rounded up to a multiple of MIN_ITERATIONS, within what views start at.
+static inline int round_iterations(double n) {
+	return clamp((int)ceil(n / MIN_ITERATIONS) * MIN_ITERATIONS, MIN_ITERATIONS, MAX_ITERATIONS);
 }
 
-Vector<uint8_t> mandelbrot(const RectD &rf, const Vec2i &size) {
-	Vector<uint8_t> data(area(size)*4);
-	const double px = (rf.max.x - rf.min.x) / (double)size.x; // pixel width
-	const double py = (rf.max.y - rf.min.y) / (double)size.y; // pixel height
-	const double dx = px / 4.0f; // 1/4 of a pixel
-	const double dy = py / 4.0f;
-	const double offx = px / 2.0f; // 1/2 of a pixel
-	const double offy = py / 2.0f;
+// Zoom depth of a view with pixels of `pixel`, in halvings of DEFAULT_PIXEL.
+static inline double zoom_depth(const FloatExp &pixel) {
+	return max(0.0, log2(DEFAULT_PIXEL) - (log2(pixel.m) + (double)pixel.e));
+}
+
+// Periodicity check tolerance, never larger than PERIODICITY_EPS and never
+// larger than a small fraction of a pixel, otherwise slowly escaping points
+// near the set boundary get mistaken for interior ones.
+static inline constexpr double PERIODICITY_EPS = 1e-10;
+
+// Deepest zoom, pixels have to stay well above the HPReal resolution.
+static inline constexpr int MIN_PIXEL_EXP = 64 - HPReal::FRACTION_BITS;
+
+static inline ComplexDD to_complex_dd(const HPVec2 &v) {
+	const double x = (double)v.x;
+	const double y = (double)v.y;
+	return {{x, (double)(v.x - HPReal(x))}, {y, (double)(v.y - HPReal(y))}};
+}
+
+// Formulas the view switches between with keys 1-5, and where on the plane
+// screen pixel (0, 0) starts for them.
+struct FormulaInfo {
+	Formula formula;
+	const char *name;
+	double x, y;
+};
+
+static inline constexpr FormulaInfo FORMULAS[] = {
+	{Formula::MANDELBROT, "mandelbrot", -1.5, -1.0},
+	{Formula::JULIA, "julia", -1.5, -0.85},
+	{Formula::BURNING_SHIP, "burning ship", -2.2, -1.4},
+	{Formula::MULTIBROT3, "multibrot^3", -1.5, -0.85},
+	{Formula::MULTIBROT4, "multibrot^4", -1.5, -0.85},
+};
+
+// Formulas whose escape time at conj(c) is that at c, the ones iterating a
+// polynomial with real coefficients in z and c.
+static inline bool conjugate_symmetric(Formula formula) {
+	return formula == Formula::MANDELBROT || formula == Formula::MULTIBROT3 || formula == Formula::MULTIBROT4;
+}
+
+// Farthest the real axis may be from the view origin, in pixels, to be
+// snapped to a tile boundary and mirrored across.
+static inline constexpr double MAX_AXIS_DISTANCE = 1 << 24;
+
+// Everything tiles need to know about the current zoom level. Immutable once
+// created, except for the escape histogram and references for raised
+// iteration limits, and shared by all tiles of the view. Reference counting
+// is main thread only, tiles are created and destroyed there.
+struct View {
+	int refs = 1;
+	Formula formula = Formula::MANDELBROT;
+	Vec2d julia_c = Vec2d(0); // for Formula::JULIA
+	HPVec2 offset; // coordinates of screen pixel (0, 0)
+	Vec2d scale; // size of a pixel, in units of 2^delta_exp
+	int delta_exp = 0;
+	Precision precision = Precision::DOUBLE;
+	ComplexDD origin; // offset for Precision::DOUBLE_DOUBLE
+	Vec2d ref_pixel = Vec2d(0); // reference point in screen pixels
+	Reference ref; // up to max_iter, see reference()
+	int max_iter = MIN_ITERATIONS; // starting iteration limit of tiles
+	EscapeHistogram escapes; // pixels of finished tiles, the one mutable part, main thread only
+
+	// `ref` continued for raised iteration limits, longest last. Added by the
+	// first tile needing them and never changed after, so orbits handed out
+	// stay valid.
+	mutable Vector<UniquePtr<Reference>> raised_refs;
+	mutable SDL_mutex *raised_mutex;
+
+	View(const HPVec2 &offset, const FloatExp &pixel, const Vec2d &center_pixel, int max_iter,
+		Formula formula = Formula::MANDELBROT, const Vec2d &julia_c = Vec2d(0)):
+		formula(formula), julia_c(julia_c), offset(offset), max_iter(max_iter), raised_mutex(SDL_CreateMutex())
+	{
+		if (pixel.e < FLOATEXP_THRESHOLD)
+			delta_exp = (int)pixel.e;
+		scale = Vec2d((double)FloatExp(pixel.m, pixel.e - delta_exp));
+
+		const HPVec2 center = to_plane(center_pixel);
+		precision = choose_precision(pixel, max(std::abs((double)center.x), std::abs((double)center.y)));
+		// deeper kernels do Mandelbrot only, see TileManager::zoom()
+		if (formula != Formula::MANDELBROT && precision > Precision::DOUBLE)
+			precision = Precision::DOUBLE;
+		if (precision == Precision::DOUBLE_DOUBLE)
+			origin = to_complex_dd(offset);
+		if (reference()) {
+			ref_pixel = center_pixel;
+			ref.compute(center, max_iter, delta_exp);
+		}
+	}
+	~View() {
+		SDL_DestroyMutex(raised_mutex);
+	}
+	NG_DELETE_COPY_AND_MOVE(View);
+
+	HPVec2 to_plane(const Vec2d &pixel) const {
+		return HPVec2(HPReal(pixel.x * scale.x, delta_exp) + offset.x, HPReal(pixel.y * scale.y, delta_exp) + offset.y);
+	}
+
+	// Complex plane coordinates of a screen pixel, relative to the origin or
+	// the reference point, depending on precision.
+	Vec2d point(const Vec2d &pixel) const {
+		switch (precision) {
+		case Precision::FLOAT:
+		case Precision::DOUBLE:
+			return pixel * scale + Vec2d((double)offset.x, (double)offset.y);
+		case Precision::DOUBLE_DOUBLE:
+			return pixel * scale;
+		case Precision::PERTURBATION:
+		case Precision::PERTURBATION_FLOATEXP:
+			return (pixel - ref_pixel) * scale;
+		}
+		return Vec2d(0);
+	}
+
+	// same as point(), for a screen rect
+	RectD rect(const Rect &r) const {
+		return rect_to_rectd(r, scale, point(Vec2d(0)));
+	}
+
+	// Iterates points given in rect() coordinates, see Kernel.h for `smooth`,
+	// `state` and `dist`. Deeper than double precision there are no distance
+	// estimates, `dist` gets zeroes.
+	void iterate(Slice<int> iters, Slice<float> smooth, Slice<const double> x, Slice<const double> y,
+		const KernelParams &params, KernelStats *stats = nullptr, const ReferenceOrbit *orbit = nullptr,
+		const OrbitState *state = nullptr, Slice<float> dist = {}) const
+	{
+		switch (precision) {
+		case Precision::FLOAT:
+			escape_time_float(iters, smooth, x, y, params, stats, state, dist);
+			return;
+		case Precision::DOUBLE:
+			escape_time(iters, smooth, x, y, params, stats, state, dist);
+			return;
+		case Precision::DOUBLE_DOUBLE:
+			escape_time_dd(iters, smooth, x, y, origin, params, stats, state);
+			break;
+		case Precision::PERTURBATION:
+		case Precision::PERTURBATION_FLOATEXP:
+			perturbation(iters, smooth, x, y, orbit ? *orbit : ref.orbit(), params, stats, state);
+			break;
+		}
+		for (int i = 0; i < dist.length; i++)
+			dist[i] = 0.0f;
+	}
+
+	const Reference *reference() const {
+		return precision >= Precision::PERTURBATION ? &ref : nullptr;
+	}
+
+	// Same, long enough for iteration limit `max_iter`. Past the starting
+	// limit the first worker asking continues the orbit, others wait for it.
+	const Reference *reference(int max_iter) const {
+		if (!reference())
+			return nullptr;
+		if (max_iter <= ref.max_iter || ref.escaped())
+			return &ref;
+		SDL_LockMutex(raised_mutex);
+		DEFER { SDL_UnlockMutex(raised_mutex); };
+		const Reference *last = &ref;
+		for (const UniquePtr<Reference> &r : raised_refs) {
+			if (max_iter <= r->max_iter || r->escaped())
+				return r.get();
+			last = r.get();
+		}
+		Reference *r = new_obj<Reference>(*last);
+		r->extend(max_iter);
+		raised_refs.append(UniquePtr<Reference>(r));
+		return r;
+	}
+
+	// iterations the palette repeats after
+	int palette_period() const {
+		return PALETTE_SPAN * max_iter;
+	}
+
+	KernelParams kernel_params(double pixel, int max_iter) const {
+		KernelParams p;
+		p.max_iter = max_iter;
+		p.formula = formula;
+		p.julia_cr = julia_c.x;
+		p.julia_ci = julia_c.y;
+		p.periodicity_eps = min(PERIODICITY_EPS, pixel * 1e-3);
+		return p;
+	}
+};
+
+View *retain_view(View *v) {
+	v->refs++;
+	return v;
+}
+
+void release_view(View *v) {
+	if (--v->refs == 0)
+		del_obj(v);
+}
+
+// Smooth escape time of a single screen pixel.
+float mandelbrot_at(const View &v, const Vec2d &pixel) {
+	int iters;
+	float smooth;
+	const Vec2d c = v.point(pixel);
+	v.iterate(Slice<int>(&iters, 1), Slice<float>(&smooth, 1), Slice<const double>(&c.x, 1),
+		Slice<const double>(&c.y, 1), v.kernel_params(v.scale.x, v.max_iter));
+	return smooth;
+}
+
+// Perturbation samples whose delta cancels the reference to within this
+// fraction are glitched and get re-rendered against another reference.
+static inline constexpr double GLITCH_TOLERANCE = 1e-6;
+static inline constexpr int MAX_GLITCH_REFERENCES = 8;
+
+// Re-renders GLITCHED samples against secondary references. Each round picks
+// the glitched sample closest to the centroid of all glitched ones as the new
+// reference point, so it lands inside the glitch. `sample_dc(i)` returns the
+// offset of sample `i` from `ref`. Whatever is still glitched after the last
+// round is rendered with glitch detection off.
+template <typename F>
+void fix_glitches(Slice<int> iters, Slice<float> smooth, const Reference &ref, const KernelParams &params,
+	KernelStats *stats, F &&sample_dc)
+{
+	Vector<int> glitched;
+	for (int i = 0; i < iters.length; i++) {
+		if (iters[i] == GLITCHED)
+			glitched.append(i);
+	}
+
+	Vector<double> dr, di;
+	Vector<int> out;
+	Vector<float> out_smooth;
+	Reference secondary;
+	for (int round = 0; round < MAX_GLITCH_REFERENCES && glitched.length() != 0 && !params.cancelled(); round++) {
+		Vec2d centroid(0);
+		for (int idx : glitched)
+			centroid += sample_dc(idx);
+		centroid /= Vec2d(glitched.length());
+
+		Vec2d dc0 = sample_dc(glitched[0]);
+		for (int idx : glitched) {
+			const Vec2d dc = sample_dc(idx);
+			if (distance2(dc, centroid) < distance2(dc0, centroid))
+				dc0 = dc;
+		}
+		secondary.compute(HPVec2(ref.c.x + HPReal(dc0.x, ref.delta_exp), ref.c.y + HPReal(dc0.y, ref.delta_exp)),
+			params.max_iter, ref.delta_exp);
+		if (stats)
+			stats->glitch_references++;
+
+		dr.resize(glitched.length());
+		di.resize(glitched.length());
+		out.resize(glitched.length());
+		out_smooth.resize(glitched.length());
+		for (int i = 0; i < glitched.length(); i++) {
+			const Vec2d dc = sample_dc(glitched[i]) - dc0;
+			dr[i] = dc.x;
+			di[i] = dc.y;
+		}
+		KernelParams p = params;
+		if (round == MAX_GLITCH_REFERENCES-1)
+			p.glitch_tolerance = 0.0;
+		perturbation(out.sub(), out_smooth.sub(), dr.sub(), di.sub(), secondary.orbit(), p, stats);
+
+		int n = 0;
+		for (int i = 0; i < glitched.length(); i++) {
+			iters[glitched[i]] = out[i];
+			smooth[glitched[i]] = out_smooth[i];
+			if (out[i] == GLITCHED)
+				glitched[n++] = glitched[i];
+		}
+		glitched.resize(n);
+	}
+}
+
+// Orbit of a sample that may have to be continued at a higher iteration
+// limit, see OrbitState. `iter` is ORBIT_DONE for finished samples.
+struct SavedOrbit {
+	int sample = 0; // see TileOrbits
+	int iter = 0;
+	double zr = 0.0, zi = 0.0;
+	double zr_lo = 0.0, zi_lo = 0.0;
+};
+
+// Iterates samples `idx` of `iters` and `smooth`, `pos(i)` is the position of
+// sample i in view.rect() coordinates. If `orbits` isn't empty, sample i
+// continues from orbits[i] and its orbit is saved there. Same for distance
+// estimates and `dist`.
+template <typename F>
+void iterate_samples(const View &view, Slice<int> iters, Slice<float> smooth, Slice<const int> idx,
+	const KernelParams &params, const ReferenceOrbit &orbit, KernelStats *stats, F &&pos,
+	Slice<SavedOrbit> orbits = {}, Slice<float> dist = {})
+{
+	const auto run = [&](Slice<const int> batch) {
+		const int n = batch.length;
+		Vector<double> cr(n);
+		Vector<double> ci(n);
+		Vector<int> out(n);
+		Vector<float> out_smooth(n);
+		Vector<float> out_dist(dist.length != 0 ? n : 0);
+		for (int i = 0; i < n; i++) {
+			const Vec2d c = pos(batch[i]);
+			cr[i] = c.x;
+			ci[i] = c.y;
+		}
+		if (!orbits) {
+			view.iterate(out.sub(), out_smooth.sub(), cr.sub(), ci.sub(), params, stats, &orbit, nullptr,
+				out_dist.sub());
+		} else {
+			Vector<int> iter(n);
+			Vector<double> zr(n), zi(n), zr_lo(n), zi_lo(n);
+			for (int i = 0; i < n; i++) {
+				const SavedOrbit &o = orbits[batch[i]];
+				iter[i] = o.iter;
+				zr[i] = o.zr;
+				zi[i] = o.zi;
+				zr_lo[i] = o.zr_lo;
+				zi_lo[i] = o.zi_lo;
+			}
+			const OrbitState state = {iter.sub(), zr.sub(), zi.sub(), zr_lo.sub(), zi_lo.sub()};
+			view.iterate(out.sub(), out_smooth.sub(), cr.sub(), ci.sub(), params, stats, &orbit, &state,
+				out_dist.sub());
+			for (int i = 0; i < n; i++) {
+				SavedOrbit &o = orbits[batch[i]];
+				o.iter = iter[i];
+				o.zr = zr[i];
+				o.zi = zi[i];
+				o.zr_lo = zr_lo[i];
+				o.zi_lo = zi_lo[i];
+			}
+		}
+		for (int i = 0; i < n; i++) {
+			iters[batch[i]] = out[i];
+			smooth[batch[i]] = out_smooth[i];
+			if (dist.length != 0)
+				dist[batch[i]] = out_dist[i];
+		}
+	};
+	if (!orbits) {
+		run(idx);
+		return;
+	}
+
+	// kernels continue all points of a call from the same iteration
+	Vector<int> rest(idx);
+	Vector<int> group;
+	while (rest.length() != 0) {
+		const int start = orbits[rest[0]].iter;
+		NG_ASSERT(start != ORBIT_DONE);
+		group.clear();
+		int n = 0;
+		for (int i : rest) {
+			if (orbits[i].iter == start)
+				group.append(i);
+			else
+				rest[n++] = i;
+		}
+		rest.resize(n);
+		run(group.sub());
+	}
+}
+
+// Mariani-Silver subdivision: rectangles of the sample grid (borders included)
+// whose border has a single iteration count are filled with it, as the set and
+// the escape time bands have no holes. Rectangles a corner of which is farther
+// from the set than their diagonal, by its distance estimate, are filled from
+// the corners without iterating the border: they hold no part of the set and
+// escape times vary smoothly over them. Rectangles narrower than this are
+// iterated in full.
+static inline constexpr int MIN_SUBDIVIDE = 6;
+
+// Fills `iters` and `smooth`, `grid` sized arrays of samples, by subdivision
+// of `rects`, which have to cover the grid. Samples marked in `done` are
+// already known and aren't iterated again, on return all of them are marked.
+// Smooth escape times of filled samples are interpolated from the border.
+// `orbits` and `dist` are passed on to iterate_samples(), filled samples keep
+// their orbits. Without `dist` only uniform borders are filled.
+template <typename F>
+void subdivide(const View &view, Slice<int> iters, Slice<float> smooth, const Vec2i &grid, Vector<Rect> rects,
+	BitArray *done, const KernelParams &params, const ReferenceOrbit &orbit, KernelStats *stats, F &&pos,
+	Slice<SavedOrbit> orbits = {}, Slice<float> dist = {})
+{
+	// Rectangles are processed a generation at a time, samples of all of them
+	// go to the kernel as one batch.
+	Vector<Rect> next;
+	Vector<int> batch;
+	BitArray &queued = *done; // samples computed or about to be
+	const auto queue = [&](const Rect &r) {
+		for (int y = r.min.y; y <= r.max.y; y++) {
+			for (int x = r.min.x; x <= r.max.x; x++) {
+				const int idx = y * grid.x + x;
+				if (!queued.test_bit(idx)) {
+					queued.set_bit(idx);
+					batch.append(idx);
+				}
+			}
+		}
+	};
+	const auto queue_border = [&](const Rect &r) {
+		queue(Rect(r.min.x, r.min.y, r.max.x, r.min.y));
+		queue(Rect(r.min.x, r.max.y, r.max.x, r.max.y));
+		queue(Rect(r.min.x, r.min.y, r.min.x, r.max.y));
+		queue(Rect(r.max.x, r.min.y, r.max.x, r.max.y));
+	};
+	const auto uniform_border = [&](const Rect &r) {
+		const int v = iters[r.min.y * grid.x + r.min.x];
+		if (v == GLITCHED)
+			return false;
+		for (int x = r.min.x; x <= r.max.x; x++) {
+			if (iters[r.min.y * grid.x + x] != v || iters[r.max.y * grid.x + x] != v)
+				return false;
+		}
+		for (int y = r.min.y; y <= r.max.y; y++) {
+			if (iters[y * grid.x + r.min.x] != v || iters[y * grid.x + r.max.x] != v)
+				return false;
+		}
+		return true;
+	};
+	// Filled samples get the distance the corner's estimate guarantees, still
+	// a lower bound by the triangle inequality.
+	const auto fill_exterior = [&](const Rect &r) {
+		if (!dist)
+			return false;
+		const int corners[] = {
+			r.min.y * grid.x + r.min.x, r.min.y * grid.x + r.max.x,
+			r.max.y * grid.x + r.min.x, r.max.y * grid.x + r.max.x,
+		};
+		const double diagonal = length(pos(corners[3]) - pos(corners[0]));
+		int clear = -1;
+		for (int idx : corners) {
+			if (!queued.test_bit(idx))
+				return false;
+			if (dist[idx] >= diagonal)
+				clear = idx;
+		}
+		if (clear < 0)
+			return false;
+		for (int y = r.min.y; y <= r.max.y; y++) {
+			const float ty = (float)(y - r.min.y) / (float)max(r.max.y - r.min.y, 1);
+			for (int x = r.min.x; x <= r.max.x; x++) {
+				const int idx = y * grid.x + x;
+				if (queued.test_bit(idx))
+					continue;
+				const float tx = (float)(x - r.min.x) / (float)max(r.max.x - r.min.x, 1);
+				const float s = lerp(
+					lerp(smooth[corners[0]], smooth[corners[1]], tx),
+					lerp(smooth[corners[2]], smooth[corners[3]], tx), ty);
+				queued.set_bit(idx);
+				iters[idx] = max((int)s, 0);
+				smooth[idx] = s;
+				dist[idx] = max(dist[clear] - (float)length(pos(idx) - pos(clear)), 0.0f);
+				if (stats)
+					stats->distance_filled++;
+			}
+		}
+		return true;
+	};
+
+	while (rects.length() != 0) {
+		// corners are known from the previous generation, if at all
+		int n = 0;
+		for (const Rect &r : rects) {
+			if (!fill_exterior(r))
+				rects[n++] = r;
+		}
+		rects.resize(n);
+
+		batch.clear();
+		for (const Rect &r : rects) {
+			if (r.width() < MIN_SUBDIVIDE || r.height() < MIN_SUBDIVIDE)
+				queue(r);
+			else
+				queue_border(r);
+		}
+		iterate_samples(view, iters, smooth, batch.sub(), params, orbit, stats, pos, orbits, dist);
+		if (params.cancelled())
+			return;
+
+		next.clear();
+		for (const Rect &r : rects) {
+			if (r.width() < MIN_SUBDIVIDE || r.height() < MIN_SUBDIVIDE)
+				continue;
+			if (uniform_border(r)) {
+				const int v = iters[r.min.y * grid.x + r.min.x];
+				const auto at = [&](int x, int y) { return smooth[y * grid.x + x]; };
+				for (int y = r.min.y + 1; y < r.max.y; y++) {
+					const float ty = (float)(y - r.min.y) / (float)(r.max.y - r.min.y);
+					for (int x = r.min.x + 1; x < r.max.x; x++) {
+						const int idx = y * grid.x + x;
+						if (!queued.test_bit(idx)) {
+							const float tx = (float)(x - r.min.x) / (float)(r.max.x - r.min.x);
+							queued.set_bit(idx);
+							iters[idx] = v;
+							smooth[idx] = v == params.max_iter ? (float)v : 0.5f * (
+								lerp(at(r.min.x, y), at(r.max.x, y), tx) + lerp(at(x, r.min.y), at(x, r.max.y), ty));
+							if (stats)
+								stats->subdivision_filled++;
+						}
+					}
+				}
+				continue;
+			}
+			// split in half across the longer side, the halves share the
+			// middle line
+			if (r.width() >= r.height()) {
+				const int mid = (r.min.x + r.max.x) / 2;
+				next.append(Rect(r.min.x, r.min.y, mid, r.max.y));
+				next.append(Rect(mid, r.min.y, r.max.x, r.max.y));
+			} else {
+				const int mid = (r.min.y + r.max.y) / 2;
+				next.append(Rect(r.min.x, r.min.y, r.max.x, mid));
+				next.append(Rect(r.min.x, mid, r.max.x, r.max.y));
+			}
+		}
+		std::swap(rects, next);
+	}
+}
+
+// Pixels whose smooth escape time differs from a neighbour by more than this
+// many palette entries get supersampled, see smooth_color(). Measured on
+// escape times scaled to the palette period rather than on colors, so that
+// recoloring doesn't need new samples. Deep views have long periods, absolute
+// differences of a few iterations don't show there.
+static inline constexpr float AA_THRESHOLD = 3.0f;
+
+// Supersampling patterns: COUNT samples per pixel, sample k is at offset(k)
+// from the top left corner of the pixel, in pixels.
+template <int SIDE>
+struct GridPattern {
+	static constexpr int COUNT = SIDE * SIDE;
+	static Vec2d offset(int k) {
+		return Vec2d(((double)(k % SIDE) + 0.5) / SIDE, ((double)(k / SIDE) + 0.5) / SIDE);
+	}
+};
+
+// Smooth escape times of a rendered tile LOD, one per pixel. Pixels listed in
+// `edge` also have `per_edge` supersamples in `edge_samples`, those of edge
+// pixel i start at i*per_edge. Kept with the tile, so that it can be colored
+// again without iterating anything.
+struct TileSamples {
+	Vec2i size = Vec2i(0);
+	int max_iter = 0; // escape times of interior samples
+	int palette_period = PALETTE_SIZE; // see smooth_color()
+	Vector<float> pixels;
+	Vector<int> edge;
+	int per_edge = 0;
+	Vector<float> edge_samples;
+};
+
+// What raising the iteration limit of a tile LOD needs besides its
+// TileSamples: iteration counts of the pixels and orbits of the samples still
+// going at the limit. Samples are numbered pixels first, then edge samples in
+// TileSamples order. Samples reused from a coarser LOD keep the orbits saved
+// there. Interior samples filled in by subdivision are saved too, with nothing
+// done, they weren't proven interior: they start over at the higher limit and
+// aren't counted as resumed.
+struct TileOrbits {
+	Vector<int> iters;
+	Vector<SavedOrbit> saved; // by sample
+};
+
+// Iterates Pattern samples of `ts` edge pixels from `first` on into its
+// edge_samples. With `orbits`, saved orbits of the earlier edge samples are
+// continued as well, and whatever is unfinished at params.max_iter is saved.
+template <typename Pattern>
+void supersample(const View &view, const RectD &rf, const KernelParams &params, const ReferenceOrbit &orbit,
+	KernelStats *stats, int first, TileSamples *ts, TileOrbits *orbits)
+{
+	const int n = Pattern::COUNT;
+	const Vec2i size = ts->size;
+	const int pixels = area(size);
+	ts->per_edge = n;
+	ts->edge_samples.resize(ts->edge.length() * n);
+
+	// samples to iterate, continuing saved ones
+	Vector<int> idx;
+	Vector<SavedOrbit> sample_orbits;
+	if (orbits) {
+		sample_orbits.resize(ts->edge_samples.length());
+		for (SavedOrbit &o : sample_orbits)
+			o.iter = ORBIT_DONE;
+		int kept = 0;
+		for (const SavedOrbit &o : orbits->saved) {
+			if (o.sample < pixels) {
+				orbits->saved[kept++] = o;
+			} else {
+				sample_orbits[o.sample - pixels] = o;
+				idx.append(o.sample - pixels);
+			}
+		}
+		orbits->saved.resize(kept);
+		for (int i = first * n; i < sample_orbits.length(); i++)
+			sample_orbits[i] = SavedOrbit();
+	}
+	for (int i = first * n; i < ts->edge_samples.length(); i++)
+		idx.append(i);
+	if (idx.length() == 0)
+		return;
+
+	const Reference *ref = view.reference();
+	const double px = (rf.max.x - rf.min.x) / (double)size.x;
+	const double py = (rf.max.y - rf.min.y) / (double)size.y;
+	// sample k of edge pixel i is at index i*n+k
+	const auto sample_pos = [&](int idx) {
+		const int pixel = ts->edge[idx / n];
+		const Vec2d o = Pattern::offset(idx % n);
+		return Vec2d(
+			((double)(pixel % size.x) + o.x) * px + rf.min.x,
+			((double)(pixel / size.x) + o.y) * py + rf.min.y);
+	};
+	Vector<int> samples(ts->edge_samples.length(), 0);
+	iterate_samples(view, samples.sub(), ts->edge_samples.sub(), idx.sub(), params, orbit, stats, sample_pos,
+		sample_orbits.sub());
+	if (ref)
+		fix_glitches(samples.sub(), ts->edge_samples.sub(), *ref, params, stats, sample_pos);
+	if (orbits) {
+		for (int i : idx) {
+			if (samples[i] == params.max_iter && sample_orbits[i].iter != ORBIT_DONE) {
+				sample_orbits[i].sample = pixels + i;
+				orbits->saved.append(sample_orbits[i]);
+			}
+		}
+	}
+	if (stats)
+		stats->supersampled += ts->edge.length() - first;
+}
+
+// Supersampling AA where the image isn't flat: pixels that differ from any of
+// their 8 neighbours get a side x side grid of samples, averaged when colored.
+// Adds such pixels to the edge pixels `ts` already has, see supersample().
+void antialias(const View &view, const RectD &rf, const KernelParams &params, const ReferenceOrbit &orbit,
+	KernelStats *stats, TileSamples *ts, TileOrbits *orbits)
+{
+	const int side = aaSamples == 16 ? 4 : aaSamples == 4 ? 2 : 1;
+	if (side == 1)
+		return;
+	const Vec2i size = ts->size;
+	const Vector<float> &smooth = ts->pixels;
+	const float threshold = AA_THRESHOLD * (float)ts->palette_period / (float)PALETTE_SIZE;
+	const int first = ts->edge.length();
+	BitArray edge(area(size));
+	for (int i : ts->edge)
+		edge.set_bit(i);
 	for (int y = 0; y < size.y; y++) {
-		const double i = (double)y * py + rf.min.y + offy;
 		for (int x = 0; x < size.x; x++) {
-			const double r = (double)x * px + rf.min.x + offx;
+			const float mu = smooth[y * size.x + x];
+			bool differs = false;
+			for (int ny = max(y - 1, 0); ny <= min(y + 1, size.y - 1) && !differs; ny++) {
+				for (int nx = max(x - 1, 0); nx <= min(x + 1, size.x - 1) && !differs; nx++)
+					differs = std::abs(mu - smooth[ny * size.x + nx]) > threshold;
+			}
+			if (differs && !edge.test_bit(y * size.x + x))
+				ts->edge.append(y * size.x + x);
+		}
+	}
+	switch (side) {
+	case 2:
+		supersample<GridPattern<2>>(view, rf, params, orbit, stats, first, ts, orbits);
+		break;
+	case 4:
+		supersample<GridPattern<4>>(view, rf, params, orbit, stats, first, ts, orbits);
+		break;
+	}
+}
+
+// Escape times of the one sample per pixel pass of a LOD, `step` is its
+// pixel size in full resolution pixels. The sample of pixel (x, y) is at the
+// center of full resolution pixel (x*step + step/2, y*step + step/2), so
+// samples of a LOD are a subset of the samples of any finer one.
+struct LodSamples {
+	Vector<int> iters;
+	Vector<float> smooth;
+	Vector<float> dist; // distance estimates, empty deeper than double precision
+	Vector<SavedOrbit> orbits; // where they stopped at the iteration limit, see TileOrbits
+	Vec2i size = Vec2i(0);
+	int step = 1;
+};
 
-			// some form of supersampling AA, probably not the best one
-			const RGBA8 c0 = mandelbrot_at(std::complex<double>(r-dx, i-dy));
-			const RGBA8 c1 = mandelbrot_at(std::complex<double>(r+dx, i-dy));
-			const RGBA8 c2 = mandelbrot_at(std::complex<double>(r-dx, i+dy));
-			const RGBA8 c3 = mandelbrot_at(std::complex<double>(r+dx, i+dy));
-			const RGBA8 color = lerp( lerp(c0, c1, 0.5f), lerp(c2, c3, 0.5f), 0.5f );
+// Splits the `coarse` LOD samples into rectangles of a single iteration count,
+// or down to single cells between 4 samples, and maps them onto the samples of
+// a finer LOD. Rectangles on the edge of the coarse grid are extended to the
+// edge of the fine one. Uniform coarse rectangles are likely uniform in the
+// fine LOD too, so subdivision starting from these only has to check their
+// borders, and doesn't spend time on borders across regions with structure.
+void coarse_regions(const LodSamples &coarse, const Vec2i &size, int step, Vector<Rect> *out)
+{
+	const auto uniform = [&](const Rect &r) {
+		const int v = coarse.iters[r.min.y * coarse.size.x + r.min.x];
+		for (int y = r.min.y; y <= r.max.y; y++) {
+			for (int x = r.min.x; x <= r.max.x; x++) {
+				if (coarse.iters[y * coarse.size.x + x] != v)
+					return false;
+			}
+		}
+		return true;
+	};
+	const auto to_fine = [&](int c, int last, int fine_last) {
+		if (c == 0)
+			return 0;
+		if (c == last)
+			return fine_last;
+		return (c * coarse.step + coarse.step / 2 - step / 2) / step;
+	};
+
+	Vector<Rect> rects;
+	rects.append(Rect_WH(Vec2i(0), coarse.size));
+	while (rects.length() != 0) {
+		const Rect r = rects[rects.length()-1];
+		rects.remove(rects.length()-1);
+		const bool cell = r.width() <= 2 && r.height() <= 2;
+		if (cell || uniform(r)) {
+			out->append(Rect(
+				to_fine(r.min.x, coarse.size.x - 1, size.x - 1), to_fine(r.min.y, coarse.size.y - 1, size.y - 1),
+				to_fine(r.max.x, coarse.size.x - 1, size.x - 1), to_fine(r.max.y, coarse.size.y - 1, size.y - 1)));
+		} else if (r.width() >= r.height()) {
+			const int mid = (r.min.x + r.max.x) / 2;
+			rects.append(Rect(r.min.x, r.min.y, mid, r.max.y));
+			rects.append(Rect(mid, r.min.y, r.max.x, r.max.y));
+		} else {
+			const int mid = (r.min.y + r.max.y) / 2;
+			rects.append(Rect(r.min.x, r.min.y, r.max.x, mid));
+			rects.append(Rect(r.min.x, mid, r.max.x, r.max.y));
+		}
+	}
+}
 
-			// NOTE: comment out lines above and uncomment line below to turn off AA
-			// const RGBA8 color = mandelbrot_at(std::complex<double>(r, i));
+// Kernel parameters and reference orbit for rendering `rf` with `size` pixels.
+static void tile_params(const View &view, const RectD &rf, const Vec2i &size, int max_iter, KernelParams *params,
+	ReferenceOrbit *orbit)
+{
+	const Reference *ref = view.reference(max_iter);
+	const double px = (rf.max.x - rf.min.x) / (double)size.x; // pixel width
+	const double py = (rf.max.y - rf.min.y) / (double)size.y; // pixel height
+	*params = view.kernel_params(min(px, py), max_iter);
+	if (ref) {
+		params->glitch_tolerance = GLITCH_TOLERANCE;
+		// series approximation has to hold for every sample of the tile
+		const double radius = max(max(length(rf.min), length(rf.max)),
+			max(length(rf.top_right()), length(rf.bottom_left())));
+		*orbit = ref->orbit(max_iter, radius, seriesTolerance);
+	}
+}
 
-			const int offset = y * size.x * 4 + x * 4;
-			data[offset+0] = color.r;
-			data[offset+1] = color.g;
-			data[offset+2] = color.b;
-			data[offset+3] = color.a;
+// Renders `rf`, given in view.rect() coordinates, at the view's precision.
+// Samples of a `coarse` LOD of the same rect are reused, samples of this one
+// are stored in `out` if given, and what raise_limit() needs in `orbits`.
+// Coloring is left to color_samples(). Once `cancel` is set it gives up as
+// soon as it can, the results are garbage then, see KernelParams::cancel.
+TileSamples mandelbrot(const View &view, const RectD &rf, const Vec2i &size, int step, KernelStats *stats = nullptr,
+	const LodSamples *coarse = nullptr, LodSamples *out = nullptr, TileOrbits *orbits = nullptr,
+	const std::atomic<bool> *cancel = nullptr)
+{
+	const Reference *ref = view.reference();
+	const double px = (rf.max.x - rf.min.x) / (double)size.x;
+	const double py = (rf.max.y - rf.min.y) / (double)size.y;
+	KernelParams params;
+	ReferenceOrbit orbit;
+	tile_params(view, rf, size, view.max_iter, &params, &orbit);
+	params.cancel = cancel;
+
+	// one sample per pixel, at the center of the full resolution pixel
+	// closest to its center
+	const double center = ((double)(step / 2) + 0.5) / (double)step;
+	const auto pixel_pos = [&](int idx) {
+		return Vec2d(
+			((double)(idx % size.x) + center) * px + rf.min.x,
+			((double)(idx / size.x) + center) * py + rf.min.y);
+	};
+	Vector<int> iters(area(size));
+	Vector<float> smooth(area(size));
+	Vector<SavedOrbit> pixel_orbits(orbits || out ? area(size) : 0);
+	Vector<float> dist(view.precision <= Precision::DOUBLE ? area(size) : 0, 0.0f);
+	BitArray done(area(size));
+	Vector<Rect> regions;
+	if (coarse) {
+		NG_ASSERT(coarse->step % step == 0);
+		for (int y = 0; y < coarse->size.y; y++) {
+			for (int x = 0; x < coarse->size.x; x++) {
+				const Vec2i p = (Vec2i(x, y) * Vec2i(coarse->step) + Vec2i(coarse->step / 2 - step / 2)) / Vec2i(step);
+				const int idx = p.y * size.x + p.x;
+				iters[idx] = coarse->iters[y * coarse->size.x + x];
+				smooth[idx] = coarse->smooth[y * coarse->size.x + x];
+				if (dist.length() != 0 && coarse->dist.length() != 0)
+					dist[idx] = coarse->dist[y * coarse->size.x + x];
+				if (pixel_orbits.length() != 0 && coarse->orbits.length() != 0)
+					pixel_orbits[idx] = coarse->orbits[y * coarse->size.x + x];
+				done.set_bit(idx);
+			}
 		}
+		coarse_regions(*coarse, size, step, &regions);
+	} else {
+		regions.append(Rect_WH(Vec2i(0), size));
+	}
+	subdivide(view, iters.sub(), smooth.sub(), size, std::move(regions), &done, params, orbit, stats, pixel_pos,
+		pixel_orbits.sub(), dist.sub());
+	if (params.cancelled())
+		return TileSamples();
+	if (ref)
+		fix_glitches(iters.sub(), smooth.sub(), *ref, params, stats, pixel_pos);
+
+	TileSamples ts;
+	ts.size = size;
+	ts.max_iter = params.max_iter;
+	ts.palette_period = view.palette_period();
+	ts.pixels = smooth;
+	if (orbits) {
+		orbits->saved.clear();
+		for (int i = 0; i < pixel_orbits.length(); i++) {
+			if (iters[i] == params.max_iter && pixel_orbits[i].iter != ORBIT_DONE) {
+				pixel_orbits[i].sample = i;
+				orbits->saved.append(pixel_orbits[i]);
+			}
+		}
+		orbits->iters = iters;
+	}
+	antialias(view, rf, params, orbit, stats, &ts, orbits);
+
+	if (out) {
+		out->iters = std::move(iters);
+		out->smooth = std::move(smooth);
+		out->dist = std::move(dist);
+		out->orbits = std::move(pixel_orbits);
+		out->size = size;
+		out->step = step;
+	}
+	return ts;
+}
+
+// Raises the iteration limit of a full resolution tile LOD (step 1) rendered
+// by mandelbrot() to `max_iter`. Only the saved orbits are continued, pixels found interior
+// before stay so. Subdivision runs again over the unfinished pixels, and
+// pixels that start to differ from their neighbours get supersampled. Gives up
+// early once `cancel` is set, same as mandelbrot(), leaving `ts` and `orbits`
+// half done.
+void raise_limit(const View &view, const RectD &rf, int max_iter, KernelStats *stats, TileSamples *ts,
+	TileOrbits *orbits, const std::atomic<bool> *cancel = nullptr)
+{
+	NG_ASSERT(max_iter > ts->max_iter);
+	const Reference *ref = view.reference();
+	const Vec2i size = ts->size;
+	const int pixels = area(size);
+	const double px = (rf.max.x - rf.min.x) / (double)size.x;
+	const double py = (rf.max.y - rf.min.y) / (double)size.y;
+	KernelParams params;
+	ReferenceOrbit orbit;
+	tile_params(view, rf, size, max_iter, &params, &orbit);
+	params.cancel = cancel;
+	const auto pixel_pos = [&](int idx) {
+		return Vec2d(
+			((double)(idx % size.x) + 0.5) * px + rf.min.x,
+			((double)(idx / size.x) + 0.5) * py + rf.min.y);
+	};
+
+	Vector<int> &iters = orbits->iters;
+	Vector<float> &smooth = ts->pixels;
+	Vector<SavedOrbit> pixel_orbits(pixels);
+	for (SavedOrbit &o : pixel_orbits)
+		o.iter = ORBIT_DONE;
+	for (const SavedOrbit &o : orbits->saved) {
+		if (o.sample < pixels)
+			pixel_orbits[o.sample] = o;
+	}
+	BitArray done(pixels);
+	for (int i = 0; i < pixels; i++) {
+		if (pixel_orbits[i].iter != ORBIT_DONE)
+			continue;
+		done.set_bit(i);
+		if (iters[i] == ts->max_iter) {
+			iters[i] = max_iter;
+			smooth[i] = (float)max_iter;
+		}
+	}
+	Vector<Rect> regions;
+	regions.append(Rect_WH(Vec2i(0), size));
+	subdivide(view, iters.sub(), smooth.sub(), size, std::move(regions), &done, params, orbit, stats, pixel_pos,
+		pixel_orbits.sub());
+	if (params.cancelled())
+		return;
+	if (ref)
+		fix_glitches(iters.sub(), smooth.sub(), *ref, params, stats, pixel_pos);
+
+	// edge samples found interior before stay so as well
+	BitArray saved_edge(ts->edge_samples.length());
+	for (const SavedOrbit &o : orbits->saved) {
+		if (o.sample >= pixels)
+			saved_edge.set_bit(o.sample - pixels);
+	}
+	for (int i = 0; i < ts->edge_samples.length(); i++) {
+		if (!saved_edge.test_bit(i) && ts->edge_samples[i] >= (float)ts->max_iter)
+			ts->edge_samples[i] = (float)max_iter;
+	}
+
+	// pixels first, supersample() takes care of edge samples
+	int kept = 0;
+	for (int i = 0; i < orbits->saved.length(); i++) {
+		const SavedOrbit &o = orbits->saved[i];
+		if (o.sample >= pixels)
+			orbits->saved[kept++] = o;
+		else if (iters[o.sample] == max_iter && pixel_orbits[o.sample].iter != ORBIT_DONE)
+			orbits->saved[kept++] = pixel_orbits[o.sample];
+	}
+	orbits->saved.resize(kept);
+	ts->max_iter = max_iter;
+	antialias(view, rf, params, orbit, stats, ts, orbits);
+}
+
+// RGBA pixels of `ts` in the current palette, edge pixels are the average
+// color of their supersamples.
+Vector<uint8_t> color_samples(const TileSamples &ts)
+{
+	Vector<RGBA8> colors(ts.pixels.length());
+	for (int i = 0; i < colors.length(); i++)
+		colors[i] = smooth_color(ts.pixels[i], ts.max_iter, ts.palette_period);
+	const int n = ts.per_edge;
+	for (int i = 0; i < ts.edge.length(); i++) {
+		int sum[3] = {};
+		for (int k = 0; k < n; k++) {
+			const RGBA8 c = smooth_color(ts.edge_samples[i*n+k], ts.max_iter, ts.palette_period);
+			sum[0] += c.r;
+			sum[1] += c.g;
+			sum[2] += c.b;
+		}
+		colors[ts.edge[i]] = RGBA8((sum[0] + n/2) / n, (sum[1] + n/2) / n, (sum[2] + n/2) / n);
+	}
+
+	Vector<uint8_t> data(colors.length()*4);
+	for (int i = 0; i < colors.length(); i++) {
+		data[i*4+0] = colors[i].r;
+		data[i*4+1] = colors[i].g;
+		data[i*4+2] = colors[i].b;
+		data[i*4+3] = colors[i].a;
 	}
 	return data;
 }
 
 struct Tile {
 	bool wip = false;
-	RGBA8 color;
+	float color_mu; // escape time at the center, colored while there's no texture
 	GLuint texture[2] = { 0, 0 }; // two lods
+	TileSamples samples; // of the current lod, for recoloring
 	bool released = false;
+	// Set along with `released` unless a twin still copies from the tile,
+	// the worker building it stops early then and drops it, see drop_tile().
+	std::atomic<bool> cancel = {false};
+	// Build job state while `wip`, see push_droppable().
+	std::atomic<int> build_job = {JOB_QUEUED};
 	int current_lod = {-1}; // -1 if no texture available
+	KernelStats stats; // all lods, written by the worker that builds the tile
+	EscapeHistogram escapes; // pixels of the last lod, same
+	uint64_t build_ticks = 0; // time spent in mandelbrot(), same
+
+	// Tile across the real axis getting flipped copies of this one's samples,
+	// or the one this tile gets them from if `copy`. Main thread only, see
+	// TileManager::mirror_tile().
+	Tile *twin = nullptr;
+	bool copy = false;
 
 	const Vec2i pos;
-	Tile(const Vec2i &pos, const Vec2i &tile_size, const Vec2d &scale, const Vec2d &offset): pos(pos) {
-		const auto r = Rect_WH(pos, tile_size);
-		const auto rf = rect_to_rectd(r, scale, offset);
-		const auto center = rf.center();
-		color = mandelbrot_at(std::complex<double>(center.x, center.y));
+	View *const view;
+	Tile(const Vec2i &pos, const Vec2i &tile_size, View *view): pos(pos), view(retain_view(view)) {
+		color_mu = mandelbrot_at(*view, ToVec2d(pos) + ToVec2d(tile_size) / Vec2d(2));
 	}
 	~Tile() {
 		for (int i = 0; i < current_lod+1; i++) {
 			glDeleteTextures(1, &texture[i]);
 		}
+		if (twin) {
+			twin->twin = nullptr;
+			if (twin->released)
+				twin->cancel.store(true, std::memory_order_relaxed);
+		}
+		release_view(view);
 	}
 
 	void draw(const Vec2i &tile_size, const Vec2i &offset) {
 		switch (current_lod) {
-		case -1:
+		case -1: {
+			const RGBA8 color = smooth_color(color_mu, view->max_iter, view->palette_period());
 			glBindTexture(GL_TEXTURE_2D, 0);
 			glColor3ub(color.r, color.g, color.b);
 			draw_quad(pos - offset, tile_size, 0, 0, 1, 1);
 			glColor3ub(255, 255, 255);
 			break;
+		}
 		case 0:
 			glBindTexture(GL_TEXTURE_2D, texture[0]);
 			draw_quad(pos - offset, tile_size, 0, 0, 1, 1);
@@ -406,17 +1449,72 @@ struct Tile {
 	}
 };
 
-void release_tile(Tile *t) {
-	if (t->wip) {
+void print_tile_stats(const Tile *t) {
+	const KernelStats &s = t->stats;
+	const double ms = (double)t->build_ticks * 1000.0 / (double)SDL_GetPerformanceFrequency();
+	printf("tile %d %d: %s, %.2f ms, %lld samples, %lld skipped by cardioid/bulb test, "
+		"%lld periodic (%lld iterations saved), %lld glitched (%lld secondary references), "
+		"%lld iterations skipped by series approximation, %lld done with extended exponent, "
+		"%lld filled by subdivision, %lld by distance estimation, %lld pixels supersampled, %lld orbits resumed (%lld iterations saved), "
+		"iteration limit %d, periods:",
+		t->pos.x, t->pos.y, precision_name(t->view->precision), ms, (long long)s.samples, (long long)s.interior_skipped,
+		(long long)s.periodic, (long long)s.periodic_iters_saved,
+		(long long)s.glitched, (long long)s.glitch_references, (long long)s.series_skipped,
+		(long long)s.floatexp_iters, (long long)s.subdivision_filled, (long long)s.distance_filled,
+		(long long)s.supersampled, (long long)s.orbits_resumed, (long long)s.resumed_iters_saved,
+		t->samples.max_iter);
+	for (int i = 0; i < PERIOD_BUCKETS; i++) {
+		if (s.period_hist[i] != 0)
+			printf(" %d-%d:%lld", 1 << i, (2 << i) - 1, (long long)s.period_hist[i]);
+	}
+	printf("\n");
+}
+
+// Tiles whose build job got dropped go to `dropped`, they're deleted once
+// the worker discards the job, see TileManager::delete_dropped().
+void release_tile(Tile *t, Vector<Tile*> *dropped) {
+	if (t->wip && !t->twin && drop_job(&t->build_job)) {
+		// nobody started on it, the worker that gets the job destroys it
+		if (printStats)
+			printf("tile %d %d: dropped before building\n", t->pos.x, t->pos.y);
+		t->released = true;
+		dropped->append(t);
+	} else if (t->wip) {
 		// somebody's working on the tile, just mark it as released
 		t->released = true;
+		if (!t->twin)
+			t->cancel.store(true, std::memory_order_relaxed);
 	} else {
 		del_obj(t);
 	}
 }
 
-// returns true if object is still alive
-Task<bool> upload_texture(Tile *t, Vector<uint8_t> data, const Vec2i &size, bool finalize = false) {
+// Colors `samples` into texture `id`, which has to be of their size.
+void update_texture(GLuint id, const TileSamples &samples) {
+	const Vector<uint8_t> data = color_samples(samples);
+	glBindTexture(GL_TEXTURE_2D, id);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, samples.size.x, samples.size.y, GL_RGBA, GL_UNSIGNED_BYTE, data.data());
+}
+
+// `ts` flipped upside down, for the tile across the real axis. Edge
+// supersamples keep their order, only their average matters. LOD 0 samples
+// sit below the center of their block, flipped ones end up a pixel above,
+// which is fine for a preview.
+TileSamples flip_rows(const TileSamples &ts) {
+	TileSamples r = ts;
+	const Vec2i size = ts.size;
+	for (int y = 0; y < size.y; y++) {
+		for (int x = 0; x < size.x; x++)
+			r.pixels[(size.y-1-y)*size.x + x] = ts.pixels[y*size.x + x];
+	}
+	for (int &idx : r.edge)
+		idx = (size.y-1 - idx/size.x)*size.x + idx%size.x;
+	return r;
+}
+
+// Uploads `samples` as the next lod of `t`.
+void add_lod(Tile *t, TileSamples samples) {
+	const Vector<uint8_t> data = color_samples(samples);
 	GLuint id;
 	glGenTextures(1, &id);
 	glBindTexture(GL_TEXTURE_2D, id);
@@ -425,7 +1523,7 @@ Task<bool> upload_texture(Tile *t, Vector<uint8_t> data, const Vec2i &size, bool
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, size.x, size.y, 0, GL_RGBA,
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, samples.size.x, samples.size.y, 0, GL_RGBA,
 		      GL_UNSIGNED_BYTE, data.data());
 
 	if (glGetError() != GL_NO_ERROR) {
@@ -434,53 +1532,248 @@ Task<bool> upload_texture(Tile *t, Vector<uint8_t> data, const Vec2i &size, bool
 
 	t->current_lod++;
 	t->texture[t->current_lod] = id;
+	t->samples = std::move(samples);
+}
+
+// Gives copying tile `t` the samples of its twin, flipped. They're final with
+// `finalize`, the tiles part then.
+void copy_twin(Tile *t, bool finalize) {
+	Tile *src = t->twin;
+	TileSamples samples = flip_rows(src->samples);
+	if (t->current_lod >= 0 && t->samples.size == samples.size) {
+		update_texture(t->texture[t->current_lod], samples);
+		t->samples = std::move(samples);
+	} else {
+		add_lod(t, std::move(samples));
+	}
+	if (finalize) {
+		if (printStats)
+			printf("tile %d %d: mirrored from %d %d\n", t->pos.x, t->pos.y, src->pos.x, src->pos.y);
+		t->copy = false;
+		t->twin = nullptr;
+		src->twin = nullptr;
+	}
+}
+
+// Tail of the uploads below, returns true if the tile is still alive. A
+// released tile keeps being built while its twin copies from it.
+bool finish_upload(Tile *t, bool finalize) {
 	if (finalize) {
 		t->wip = false;
+		t->view->escapes += t->escapes;
+		if (printStats)
+			print_tile_stats(t);
 	}
-	if (t->released) {
+	if (t->twin)
+		copy_twin(t->twin, finalize);
+	if (t->released && !t->twin) {
 		del_obj(t);
-		co_return false;
+		return false;
+	}
+	return true;
+}
+
+// Uploads the next lod, returns true if object is still alive.
+Task<bool> upload_texture(Tile *t, TileSamples samples, bool finalize = false) {
+	add_lod(t, std::move(samples));
+	co_return finish_upload(t, finalize);
+}
+
+// Same as upload_texture, for new samples of the current lod.
+Task<bool> replace_texture(Tile *t, TileSamples samples, bool finalize = false) {
+	update_texture(t->texture[t->current_lod], samples);
+	t->samples = std::move(samples);
+	co_return finish_upload(t, finalize);
+}
+
+// Deletes released tile `t` whose build stopped early, `stage` tells where.
+Task<void> drop_tile(Tile *t, const char *stage) {
+	if (printStats) {
+		const double ms = (double)t->build_ticks * 1000.0 / (double)SDL_GetPerformanceFrequency();
+		printf("tile %d %d: cancelled %s, %.2f ms, %lld samples, %lld left out\n",
+			t->pos.x, t->pos.y, stage, ms, (long long)t->stats.samples, (long long)t->stats.cancelled);
 	}
-	co_return true;
+	del_obj(t);
+	co_return;
 }
 
-Task<void> build_tile(Tile *t, const Vec2i &tile_size, Vec2d scale, Vec2d offset) {
-	// LOD 0
-	const Rect r = Rect_WH(t->pos, tile_size);
-	const RectD rf = rect_to_rectd(r, scale, offset);
-	const auto data0 = mandelbrot(rf, tile_size/Vec2i(4));
-	if (!co_await co_main(upload_texture(t, std::move(data0), tile_size/Vec2i(4))))
+// Replaces `h` with the pixels of a tile LOD that escaped before `max_iter`
+// and tells whether raising the limit is worth it. It isn't if pixels escaped
+// but none in the upper half of the limit, the orbits still going are most
+// likely interior then. With no escapes at all the limit may just be too low
+// for the zoom depth.
+static bool count_escapes(const TileOrbits &orbits, int max_iter, EscapeHistogram *h) {
+	*h = EscapeHistogram();
+	bool late = false;
+	for (int n : orbits.iters) {
+		if (n < 0 || n >= max_iter)
+			continue;
+		h->add(n);
+		late |= n >= max_iter / 2;
+	}
+	return orbits.saved.length() != 0 && (late || h->total == 0);
+}
+
+Task<void> build_tile(Tile *t, const Vec2i &tile_size) {
+	// LOD 0. The rect goes from corner to corner of the tile rather than
+	// between the corners of its corner pixels, samples land on pixel
+	// centers then, mirrored across the real axis too.
+	const RectD rf = t->view->rect(Rect(t->pos, t->pos + tile_size));
+	const std::atomic<bool> *cancel = &t->cancel;
+	if (cancel->load(std::memory_order_relaxed)) {
+		co_await co_main(drop_tile(t, "before lod 0"));
+		co_return;
+	}
+	LodSamples lod0;
+	uint64_t start = SDL_GetPerformanceCounter();
+	TileSamples samples0 = mandelbrot(*t->view, rf, tile_size/Vec2i(4), 4, &t->stats, nullptr, &lod0, nullptr,
+		cancel);
+	t->build_ticks += SDL_GetPerformanceCounter() - start;
+	if (cancel->load(std::memory_order_relaxed)) {
+		co_await co_main(drop_tile(t, "at lod 0"));
+		co_return;
+	}
+	if (!co_await co_main(upload_texture(t, std::move(samples0))))
+		co_return;
+	// LOD 1, on top of LOD 0 samples
+	TileOrbits orbits;
+	start = SDL_GetPerformanceCounter();
+	TileSamples samples1 = mandelbrot(*t->view, rf, tile_size, 1, &t->stats, &lod0, nullptr, &orbits, cancel);
+	t->build_ticks += SDL_GetPerformanceCounter() - start;
+	if (cancel->load(std::memory_order_relaxed)) {
+		co_await co_main(drop_tile(t, "at lod 1"));
 		co_return;
-	// LOD 1
-	const auto data1 = mandelbrot(rf, tile_size);
-	(void)co_await co_main(upload_texture(t, std::move(data1), tile_size, true));
+	}
+	bool done = !count_escapes(orbits, samples1.max_iter, &t->escapes);
+	if (!co_await co_main(upload_texture(t, samples1, done)))
+		co_return;
+	// higher iteration limits, continuing the orbits left unfinished
+	const int ceiling = min(t->view->max_iter * MAX_RAISE, MAX_RAISED_ITERATIONS);
+	while (!done) {
+		const int max_iter = min(samples1.max_iter * RAISE_FACTOR, ceiling);
+		start = SDL_GetPerformanceCounter();
+		raise_limit(*t->view, rf, max_iter, &t->stats, &samples1, &orbits, cancel);
+		t->build_ticks += SDL_GetPerformanceCounter() - start;
+		if (cancel->load(std::memory_order_relaxed)) {
+			co_await co_main(drop_tile(t, "raising the iteration limit"));
+			co_return;
+		}
+		done = !count_escapes(orbits, max_iter, &t->escapes) || max_iter >= ceiling;
+		if (!co_await co_main(replace_texture(t, samples1, done)))
+			co_return;
+	}
 }
 
 struct TileManager {
 	Vec2i screen_offset = Vec2i(0);
-	Vec2d offset = Vec2d(-1.5, -1.0);
-	Vec2d scale = Vec2d(0.00235);
+	HPVec2 offset = HPVec2(FORMULAS[0].x, FORMULAS[0].y);
+	FloatExp scale = FloatExp(DEFAULT_PIXEL); // size of a pixel
+	int formula = 0; // index into FORMULAS
+	Vec2d julia_c = Vec2d(-0.8, 0.156);
+	View *view = nullptr;
+	bool mirrored = false; // tiles across the real axis copy each other, see snap_axis()
+	int axis = 0; // row of screen pixels the real axis is on, if mirrored
 
 	// in pixels
 	const Vec2i tile_size;
 
 	Vector<Tile*> tiles;
+	Vector<Tile*> dropped; // released before their build started, see release_tile()
 	BitArray tile_bits;
 
-	TileManager(const Vec2i &ts): tile_size(ts) {
+	TileManager(const Vec2i &ts, Rect *s): tile_size(ts) {
+		snap_axis(s);
+		new_view(*s, depth_iterations());
 	}
+	// Runs after wait_for_workers(). Jobs are gone by then, destroyed or left
+	// in the queue, and no coroutine touches tiles anymore: wip tiles are
+	// deleted as they are, without dropping their jobs.
 	~TileManager() {
 		for (auto t : tiles)
-			release_tile(t);
+			t->twin = nullptr;
+		for (auto t : tiles)
+			del_obj(t);
+		for (auto t : dropped)
+			del_obj(t);
+		release_view(view);
+	}
+
+	// Deletes dropped tiles whose jobs the workers got to.
+	void delete_dropped() {
+		for (int i = 0; i < dropped.length(); i++) {
+			if (job_discarded(&dropped[i]->build_job)) {
+				del_obj(dropped[i]);
+				dropped.quick_remove(i--);
+			}
+		}
+	}
+
+	// Copies go first, so that the tiles they copy from have no twins left
+	// and their queued builds can be dropped.
+	void release_tiles() {
+		for (auto t : tiles) {
+			if (t->copy)
+				release_tile(t, &dropped);
+		}
+		for (auto t : tiles) {
+			if (!t->copy)
+				release_tile(t, &dropped);
+		}
+		tiles.clear();
+	}
+
+	// Starting iteration limit for the current scale from zoom depth alone.
+	int depth_iterations() const {
+		return round_iterations(MIN_ITERATIONS + DEPTH_ITERATIONS * zoom_depth(scale));
+	}
+
+	// Starting iteration limit after zooming in from the current view by
+	// `ratio`: twice what 99% of the pixels of its finished tiles escaped by,
+	// plus the depth gained. Zoom depth alone if none finished.
+	int zoom_iterations(float ratio) const {
+		const int escaped = view->escapes.percentile(0.99);
+		if (escaped == 0)
+			return depth_iterations();
+		return round_iterations(2.0 * escaped - DEPTH_ITERATIONS * log2(ratio));
+	}
+
+	// Moves the view by half a pixel at most so that the real axis runs along
+	// tile boundaries, and screen rect `s` by whole pixels to show the same
+	// part of the plane. Tiles then map to tiles across the axis and no tile
+	// straddles it. Only for formulas symmetric about the axis.
+	void snap_axis(Rect *s) {
+		mirrored = false;
+		if (!conjugate_symmetric(FORMULAS[formula].formula))
+			return;
+		const double a = -(double)offset.y / (double)scale; // axis row, in pixels
+		if (!(std::abs(a) < MAX_AXIS_DISTANCE))
+			return;
+		axis = (int)round(a / tile_size.y) * tile_size.y;
+		offset.y = HPReal(-(double)axis * scale.m, scale.e);
+		s->move(Vec2i(0, axis - (int)round(a)));
+		mirrored = true;
+	}
+
+	void new_view(const Rect &s, int max_iter) {
+		if (view)
+			release_view(view);
+		view = new_obj<View>(offset, scale, ToVec2d(s.center()), max_iter, FORMULAS[formula].formula, julia_c);
+		if (printStats) {
+			printf("view: %s, %s precision, %d iterations", FORMULAS[formula].name, precision_name(view->precision),
+				view->max_iter);
+			if (view->reference())
+				printf(", reference orbit of %d iterations", view->ref.zr.length()-1);
+			printf("\n");
+		}
 	}
 
 	void reset(Rect *s) {
-		offset = Vec2d(-1.5, -1.0);
-		scale = Vec2d(0.00235);
+		offset = HPVec2(FORMULAS[formula].x, FORMULAS[formula].y);
+		scale = FloatExp(DEFAULT_PIXEL);
 		*s = Rect_WH(Vec2i(0), s->size());
-		for (auto t : tiles)
-			release_tile(t);
-		tiles.clear();
+		snap_axis(s);
+		release_tiles();
+		new_view(*s, depth_iterations());
 		update(*s);
 	}
 
@@ -489,18 +1782,82 @@ struct TileManager {
 			Vec2i(::min(a.x, b.x), ::min(a.y, b.y)),
 			Vec2i(::max(a.x, b.x), ::max(a.y, b.y)));
 
-		const auto origin = ToVec2d(s->top_left() + sr.top_left()) * scale + offset;
+		const auto origin = view->to_plane(ToVec2d(s->top_left() + sr.top_left()));
 		const auto ratio = (float)sr.width() / s->width();
-		scale *= Vec2d(ratio);
+		if ((scale * FloatExp(ratio)).e < MIN_PIXEL_EXP)
+			return;
+		if (FORMULAS[formula].formula != Formula::MANDELBROT) {
+			// other formulas have no kernels beyond double precision
+			const HPVec2 c = view->to_plane(ToVec2d(s->top_left() + sr.center()));
+			const double center = ::max(std::abs((double)c.x), std::abs((double)c.y));
+			if (choose_precision(scale * FloatExp(ratio), center) > Precision::DOUBLE)
+				return;
+		}
+		const int max_iter = zoom_iterations(ratio);
+		scale *= FloatExp(ratio);
 		offset = origin;
 		*s = Rect_WH(Vec2i(0), s->size());
+		snap_axis(s);
 
-		for (auto t : tiles)
-			release_tile(t);
-		tiles.clear();
+		release_tiles();
+		new_view(*s, max_iter);
 		update(*s);
 	}
 
+	// Switches to FORMULAS[i] at its default view. Julia sets are taken for c
+	// at the center of the screen when switching from the Mandelbrot set.
+	void set_formula(Rect *s, int i) {
+		if (i == formula)
+			return;
+		if (FORMULAS[i].formula == Formula::JULIA && FORMULAS[formula].formula == Formula::MANDELBROT) {
+			const HPVec2 c = view->to_plane(ToVec2d(s->center()));
+			julia_c = Vec2d((double)c.x, (double)c.y);
+		}
+		formula = i;
+		reset(s);
+	}
+
+	// Colors the kept samples of every tile again, after a palette change.
+	// No iterating, tiles that are still being built pick up the new palette
+	// with their next lod.
+	void recolor() {
+		const uint64_t start = SDL_GetPerformanceCounter();
+		for (auto t : tiles) {
+			if (t->current_lod >= 0)
+				update_texture(t->texture[t->current_lod], t->samples);
+		}
+		if (printStats) {
+			const double ms = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+			printf("recolor: %d tiles, %.2f ms\n", tiles.length(), ms);
+		}
+	}
+
+	Tile *find_tile(const Vec2i &pos) {
+		for (auto t : tiles) {
+			if (t->pos == pos)
+				return t;
+		}
+		return nullptr;
+	}
+
+	// Makes new tile `t` a flipped copy of the visible tile across the real
+	// axis, right away if that one is finished or with each lod it uploads
+	// otherwise. Returns false if there's no such tile or it already has a
+	// twin, `t` has to be built then.
+	bool mirror_tile(Tile *t) {
+		if (!mirrored)
+			return false;
+		Tile *twin = find_tile(Vec2i(t->pos.x, 2 * axis - t->pos.y - tile_size.y));
+		if (!twin || twin->twin || twin->copy)
+			return false;
+		t->twin = twin;
+		t->copy = true;
+		twin->twin = t;
+		if (twin->current_lod >= 0)
+			copy_twin(t, !twin->wip);
+		return true;
+	}
+
 	void update(const Rect &s) {
 		screen_offset = s.top_left();
 
@@ -522,7 +1879,7 @@ struct TileManager {
 			const Vec2i index = t->pos / tile_size - base;
 			if (!contains(visrect, index)) {
 				tiles.quick_remove(i--);
-				release_tile(t);
+				release_tile(t, &dropped);
 			} else {
 				tile_bits.set_bit(index.y * vis.x + index.x);
 			}
@@ -539,15 +1896,18 @@ struct TileManager {
 				// ok, we have a new tile here
 				const Vec2i pos = (base + Vec2i(x, y)) * tile_size;
 
-				const auto tile = new_obj<Tile>(pos, tile_size, this->scale, this->offset);
+				const auto tile = new_obj<Tile>(pos, tile_size, view);
 				tiles.append(tile);
+				if (mirror_tile(tile))
+					continue;
 				tile->wip = true;
-				globalQueue->push(build_tile(tile, tile_size, this->scale, this->offset).coro);
+				push_droppable(build_tile(tile, tile_size), &tile->build_job);
 			}
 		}
 	}
 
 	void draw() {
+		delete_dropped();
 		for (int i = 0; i < tiles.length(); i++) {
 			tiles[i]->draw(tile_size, screen_offset);
 		}
@@ -555,7 +1915,7 @@ struct TileManager {
 };
 
 void main_loop(SDL_Window *sdl_window, Rect &screen) {
-	TileManager tm(Vec2i(128));
+	TileManager tm(Vec2i(128), &screen);
 	tm.update(screen);
 
 	glClearColor(0, 0, 0, 1);
@@ -590,6 +1950,15 @@ void main_loop(SDL_Window *sdl_window, Rect &screen) {
 			case SDL_KEYDOWN:
 				if (e.key.keysym.sym == SDLK_ESCAPE)
 					done = true;
+				else if (e.key.keysym.sym >= SDLK_1 && e.key.keysym.sym < SDLK_1 + (int)(sizeof(FORMULAS)/sizeof(*FORMULAS)))
+					tm.set_formula(&screen, e.key.keysym.sym - SDLK_1);
+				else if (e.key.keysym.sym == SDLK_c) {
+					paletteShift = (paletteShift + PALETTE_SIZE / 16) % PALETTE_SIZE;
+					tm.recolor();
+				} else if (e.key.keysym.sym == SDLK_s) {
+					smoothColoring = !smoothColoring;
+					tm.recolor();
+				}
 				break;
 			case SDL_MOUSEBUTTONDOWN:
 				if (e.button.button == 1) {
@@ -665,6 +2034,17 @@ int main() {
 	glLoadIdentity();
 	glOrtho(0, screen.width(), screen.height(), 0, -1, 1);
 
+	printStats = getenv("CPPMANDEL_STATS") != nullptr;
+	if (const char *tol = getenv("CPPMANDEL_SA_TOLERANCE"))
+		seriesTolerance = atof(tol);
+	if (const char *aa = getenv("CPPMANDEL_AA")) {
+		const int n = atoi(aa);
+		if (n == 1 || n == 4 || n == 16)
+			aaSamples = n;
+		else
+			printf("unknown CPPMANDEL_AA=%s, ignoring\n", aa);
+	}
+	init_kernels();
 	init_workers();
 
 	main_loop(sdl_window, screen);